@@ -0,0 +1,338 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "compress_cache.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "compressor.h"
+
+#define MIN_BUCKETS 16
+// Budget bytes per bucket, compressed files are a few KiB
+#define BUCKET_BYTES 4096
+// Files smaller than this fit in a segment or two either way
+#define MIN_SIZE 256
+
+static size_t hash_key(const char *path, enum content_coding coding)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL ^ coding;
+    for (const unsigned char *c = (const unsigned char *)path; *c; c++)
+    {
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+struct compress_cache *compress_cache_create(size_t memory_budget)
+{
+    struct compress_cache *cache = calloc(1, sizeof(struct compress_cache));
+    if (!cache)
+        return NULL;
+
+    // Power of two buckets
+    cache->bucket_count = MIN_BUCKETS;
+    while (cache->bucket_count < memory_budget / BUCKET_BYTES)
+        cache->bucket_count *= 2;
+
+    cache->buckets =
+        calloc(cache->bucket_count, sizeof(struct compressed_entry *));
+    if (!cache->buckets)
+    {
+        free(cache);
+        return NULL;
+    }
+
+    cache->memory_budget = memory_budget;
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+static struct compressed_entry **find_slot(struct compress_cache *cache,
+                                           const char *path,
+                                           const struct timespec *mtime,
+                                           enum content_coding coding)
+{
+    size_t index = hash_key(path, coding) & (cache->bucket_count - 1);
+    struct compressed_entry **slot = &cache->buckets[index];
+
+    while (*slot
+           && ((*slot)->coding != coding
+               || (*slot)->mtime.tv_sec != mtime->tv_sec
+               || (*slot)->mtime.tv_nsec != mtime->tv_nsec
+               || strcmp((*slot)->path, path)))
+        slot = &(*slot)->hash_next;
+
+    return slot;
+}
+
+static void lru_unlink(struct compress_cache *cache,
+                       struct compressed_entry *entry)
+{
+    if (entry->lru_prev)
+        entry->lru_prev->lru_next = entry->lru_next;
+    else
+        cache->lru_head = entry->lru_next;
+
+    if (entry->lru_next)
+        entry->lru_next->lru_prev = entry->lru_prev;
+    else
+        cache->lru_tail = entry->lru_prev;
+
+    entry->lru_prev = NULL;
+    entry->lru_next = NULL;
+}
+
+static void lru_push_front(struct compress_cache *cache,
+                           struct compressed_entry *entry)
+{
+    entry->lru_next = cache->lru_head;
+    if (cache->lru_head)
+        cache->lru_head->lru_prev = entry;
+    else
+        cache->lru_tail = entry;
+
+    cache->lru_head = entry;
+}
+
+static void remove_entry(struct compress_cache *cache,
+                         struct compressed_entry *entry)
+{
+    // Responses sending the file hold their own reference
+    *find_slot(cache, entry->path, &entry->mtime, entry->coding) =
+        entry->hash_next;
+    lru_unlink(cache, entry);
+    cache->memory_used -= entry->cost;
+
+    file_cache_release(entry->file);
+    free(entry->path);
+    free(entry);
+}
+
+// Evict the least recently used entries until size more bytes fit
+static bool make_room(struct compress_cache *cache, size_t size)
+{
+    while (cache->memory_used + size > cache->memory_budget && cache->lru_tail)
+    {
+        cache->stats.evictions++;
+        remove_entry(cache, cache->lru_tail);
+    }
+
+    return cache->memory_used + size <= cache->memory_budget;
+}
+
+static void insert_entry(struct compress_cache *cache,
+                         struct compressed_entry *entry)
+{
+    size_t index =
+        hash_key(entry->path, entry->coding) & (cache->bucket_count - 1);
+    entry->hash_next = cache->buckets[index];
+    cache->buckets[index] = entry;
+    lru_push_front(cache, entry);
+    cache->memory_used += entry->cost;
+}
+
+// Store the compressed file of a pending entry, entries evicted meanwhile
+// drop it
+static void settle_job(struct compress_cache *cache, struct compress_job *job)
+{
+    struct compressed_entry *entry =
+        *find_slot(cache, job->path, &job->mtime, job->coding);
+    struct cached_file *file = job->file;
+    free(job->path);
+    free(job);
+    if (!entry || !entry->pending)
+    {
+        file_cache_release(file);
+        return;
+    }
+
+    entry->pending = false;
+    lru_unlink(cache, entry);
+    if (file && make_room(cache, file->size))
+    {
+        entry->file = file;
+        entry->cost += file->size;
+        cache->memory_used += file->size;
+    }
+    else
+        file_cache_release(file);
+    lru_push_front(cache, entry);
+}
+
+static void collect_done(struct compress_cache *cache)
+{
+    pthread_mutex_lock(&cache->lock);
+    struct compress_job *job = cache->done;
+    cache->done = NULL;
+    pthread_mutex_unlock(&cache->lock);
+
+    while (job)
+    {
+        struct compress_job *next = job->next;
+        settle_job(cache, job);
+        job = next;
+    }
+}
+
+static struct compress_job *create_job(struct compress_cache *cache,
+                                       const struct cached_file *file,
+                                       enum content_coding coding)
+{
+    struct compress_job *job = calloc(1, sizeof(struct compress_job));
+    if (job)
+        job->path = strdup(file->path);
+    if (!job || !job->path)
+    {
+        free(job);
+        return NULL;
+    }
+
+    job->cache = cache;
+    job->mtime = file->mtime;
+    job->coding = coding;
+    memcpy(job->etag, file->etag, ETAG_SIZE);
+    memcpy(job->last_modified, file->last_modified, LAST_MODIFIED_SIZE);
+    return job;
+}
+
+// Hand file to the compressing threads, with a pending entry so that it is
+// compressed once
+static void request_compression(struct compress_cache *cache,
+                                const struct cached_file *file,
+                                enum content_coding coding)
+{
+    struct compressed_entry *entry =
+        calloc(1, sizeof(struct compressed_entry));
+    struct compress_job *job = entry ? create_job(cache, file, coding) : NULL;
+    if (job)
+        entry->path = strdup(file->path);
+    if (!job || !entry->path)
+    {
+        free(job ? job->path : NULL);
+        free(job);
+        free(entry);
+        return;
+    }
+
+    // Counted before being queued, a thread may hand it back at once
+    pthread_mutex_lock(&cache->lock);
+    cache->jobs++;
+    pthread_mutex_unlock(&cache->lock);
+    if (!compress_submit(job))
+    {
+        // Queue is full, the file is compressed on a later request
+        pthread_mutex_lock(&cache->lock);
+        cache->jobs--;
+        pthread_mutex_unlock(&cache->lock);
+        free(job->path);
+        free(job);
+        free(entry->path);
+        free(entry);
+        return;
+    }
+
+    entry->mtime = file->mtime;
+    entry->coding = coding;
+    entry->pending = true;
+    entry->cost = sizeof(struct compressed_entry) + strlen(entry->path) + 1;
+    make_room(cache, entry->cost);
+    insert_entry(cache, entry);
+}
+
+unsigned compress_cache_codings(const struct compress_cache *cache,
+                                const struct cached_file *file)
+{
+    if (file->size < MIN_SIZE || (size_t)file->size > cache->memory_budget
+        || !compressible(file->path))
+        return 0;
+    return COMPRESSOR_CODINGS;
+}
+
+struct cached_file *compress_cache_get(struct compress_cache *cache,
+                                       const struct cached_file *file,
+                                       enum content_coding coding)
+{
+    collect_done(cache);
+    struct compressed_entry *entry =
+        *find_slot(cache, file->path, &file->mtime, coding);
+    if (!entry)
+    {
+        cache->stats.misses++;
+        request_compression(cache, file, coding);
+        return NULL;
+    }
+
+    lru_unlink(cache, entry);
+    lru_push_front(cache, entry);
+    if (!entry->file)
+        return NULL;
+
+    cache->stats.hits++;
+    return file_cache_retain(entry->file);
+}
+
+static void free_jobs(struct compress_job *job)
+{
+    while (job)
+    {
+        struct compress_job *next = job->next;
+        file_cache_release(job->file);
+        free(job->path);
+        free(job);
+        job = next;
+    }
+}
+
+void compress_cache_deliver(struct compress_cache *cache,
+                            struct compress_job *job)
+{
+    pthread_mutex_lock(&cache->lock);
+    cache->jobs--;
+    bool orphaned = cache->destroyed;
+    if (!orphaned)
+    {
+        job->next = cache->done;
+        cache->done = job;
+    }
+    bool last = orphaned && !cache->jobs;
+    pthread_mutex_unlock(&cache->lock);
+
+    if (!orphaned)
+        return;
+    job->next = NULL;
+    free_jobs(job);
+    if (last)
+    {
+        pthread_mutex_destroy(&cache->lock);
+        free(cache);
+    }
+}
+
+void compress_cache_destroy(struct compress_cache *cache)
+{
+    if (!cache)
+        return;
+
+    while (cache->lru_head)
+        remove_entry(cache, cache->lru_head);
+    free(cache->buckets);
+    cache->buckets = NULL;
+
+    pthread_mutex_lock(&cache->lock);
+    struct compress_job *done = cache->done;
+    cache->done = NULL;
+    cache->destroyed = true;
+    bool last = !cache->jobs;
+    pthread_mutex_unlock(&cache->lock);
+
+    free_jobs(done);
+    if (last)
+    {
+        pthread_mutex_destroy(&cache->lock);
+        free(cache);
+    }
+}
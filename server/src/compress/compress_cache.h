@@ -0,0 +1,118 @@
+#ifndef COMPRESS_CACHE_H
+#define COMPRESS_CACHE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "../http/http.h"
+#include "../utils/file/file_cache.h"
+
+struct compress_job;
+
+/*
+** @brief Compressed version of a file, keyed by the path and modification
+**        time of the file and the coding
+**
+** @param file Compressed file sent in place of the file, NULL while it is
+**        being compressed or when compressing did not make it smaller
+** @param pending The file is being compressed
+** @param cost Bytes the entry counts against the memory budget
+*/
+struct compressed_entry
+{
+    char *path;
+    struct timespec mtime;
+    enum content_coding coding;
+    struct cached_file *file;
+    bool pending;
+    size_t cost;
+
+    struct compressed_entry *hash_next;
+    struct compressed_entry *lru_prev;
+    struct compressed_entry *lru_next;
+};
+
+/*
+** @brief Counters of the cache activity
+**
+** @param hits Requests served a compressed file from the cache
+** @param misses Requests that had their file compressed
+** @param evictions Entries evicted to stay within the memory budget
+*/
+struct compress_cache_stats
+{
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+};
+
+/*
+** @brief Bounded cache of the compressed files of a worker, evicting the
+**        least recently used entry to keep them within memory_budget bytes.
+**        Files are compressed once by the compressing threads, which hand
+**        the results back through the done list, the only part shared with
+**        them. Each worker owns one
+**
+** @param lock Protects done, jobs and destroyed
+** @param done Compressions handed back and not picked up yet
+** @param jobs Compressions not handed back yet
+** @param destroyed The worker is done with the cache, the last compression
+**        handed back frees it
+*/
+struct compress_cache
+{
+    struct compressed_entry **buckets;
+    size_t bucket_count;
+    struct compressed_entry *lru_head;
+    struct compressed_entry *lru_tail;
+    size_t memory_used;
+    size_t memory_budget;
+    struct compress_cache_stats stats;
+
+    pthread_mutex_t lock;
+    struct compress_job *done;
+    size_t jobs;
+    bool destroyed;
+};
+
+/*
+** @brief Create a cache keeping at most memory_budget bytes of compressed
+**        files
+*/
+struct compress_cache *compress_cache_create(size_t memory_budget);
+
+/*
+** @brief Free the entries not used by a pending response, the cache itself
+**        is freed once the compressions in flight are handed back
+*/
+void compress_cache_destroy(struct compress_cache *cache);
+
+/*
+** @brief Tell whether file can be compressed on the fly
+**
+** @return the mask of codings it can be compressed with, 0 if none
+*/
+unsigned compress_cache_codings(const struct compress_cache *cache,
+                                const struct cached_file *file);
+
+/*
+** @brief Get file compressed with coding. On a miss, file is queued for the
+**        compressing threads and is to be sent as is in the meantime
+**
+** @return a referenced file to give back with file_cache_release, NULL if
+**         it is not compressed yet or does not get smaller
+*/
+struct cached_file *compress_cache_get(struct compress_cache *cache,
+                                       const struct cached_file *file,
+                                       enum content_coding coding);
+
+/*
+** @brief Hand a finished job back to its cache, called by the compressing
+**        threads
+*/
+void compress_cache_deliver(struct compress_cache *cache,
+                            struct compress_job *job);
+
+#endif /* ! COMPRESS_CACHE_H */
@@ -0,0 +1,271 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "compressor.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "compress_cache.h"
+
+// Jobs waiting for a thread, workers serve files as is beyond it
+#define QUEUE_MAX 256
+// zlib level, compressing runs once per file and worker
+#define GZIP_LEVEL 6
+// Window of 2^15 bytes with a gzip header and trailer
+#define GZIP_WINDOW_BITS (15 + 16)
+
+static const char *const compressible_types[] = {
+    "html", "htm", "css", "js", "mjs", "json", "svg",
+    "txt",  "xml", "csv", "md", "map", "wasm", "ico",
+};
+
+/*
+** @brief Threads compressing the files of every worker
+**
+** @param queue First job waiting for a thread, jobs are taken in order
+*/
+struct compress_pool
+{
+    pthread_t *threads;
+    unsigned thread_count;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    struct compress_job *queue;
+    struct compress_job *queue_tail;
+    size_t queued;
+    bool stopping;
+};
+
+static struct compress_pool *pool = NULL;
+
+bool compressible(const char *path)
+{
+    const char *dot = strrchr(path, '.');
+    if (!dot || strchr(dot, '/'))
+        return false;
+
+    size_t count = sizeof(compressible_types) / sizeof(*compressible_types);
+    for (size_t i = 0; i < count; i++)
+        if (!strcasecmp(dot + 1, compressible_types[i]))
+            return true;
+    return false;
+}
+
+// Read the whole file if it is still the one the job was made for
+static char *read_file(const struct compress_job *job, size_t *size)
+{
+    int fd = open(job->path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)
+        || st.st_mtim.tv_sec != job->mtime.tv_sec
+        || st.st_mtim.tv_nsec != job->mtime.tv_nsec || !st.st_size)
+    {
+        if (fd != -1)
+            close(fd);
+        return NULL;
+    }
+
+    *size = st.st_size;
+    char *data = malloc(*size);
+    size_t loaded = 0;
+    while (data && loaded < *size)
+    {
+        ssize_t n = pread(fd, data + loaded, *size - loaded, loaded);
+        if (n <= 0)
+        {
+            // Read error or file got shorter
+            free(data);
+            data = NULL;
+            break;
+        }
+        loaded += n;
+    }
+    close(fd);
+    return data;
+}
+
+// Compress data into a gzip member, NULL if it does not get smaller
+static char *gzip_data(const char *data, size_t size, size_t *compressed)
+{
+    z_stream stream = { 0 };
+    if (deflateInit2(&stream, GZIP_LEVEL, Z_DEFLATED, GZIP_WINDOW_BITS, 8,
+                     Z_DEFAULT_STRATEGY)
+        != Z_OK)
+        return NULL;
+
+    size_t bound = deflateBound(&stream, size);
+    char *out = malloc(bound);
+    stream.next_in = (Bytef *)data;
+    stream.avail_in = size;
+    stream.next_out = (Bytef *)out;
+    stream.avail_out = bound;
+    if (out && deflate(&stream, Z_FINISH) == Z_STREAM_END
+        && stream.total_out < size)
+        *compressed = stream.total_out;
+    else
+    {
+        free(out);
+        out = NULL;
+    }
+
+    deflateEnd(&stream);
+    return out;
+}
+
+// Compressed file sent from memory, with the validators of the file
+static struct cached_file *make_file(const struct compress_job *job,
+                                     char *body, size_t size)
+{
+    struct cached_file *file = calloc(1, sizeof(struct cached_file));
+    if (file)
+        file->path = strdup(job->path);
+    if (!file || !file->path)
+    {
+        free(file);
+        free(body);
+        return NULL;
+    }
+
+    file->fd = -1;
+    file->size = size;
+    file->mtime = job->mtime;
+    file->refs = 1;
+    file->body = body;
+    // Each coding is a representation of its own, "abc" becomes "abc-gzip"
+    int etag_size = strlen(job->etag);
+    snprintf(file->etag, ETAG_SIZE, "%.*s-%s\"", etag_size - 1, job->etag,
+             coding_names[job->coding]);
+    memcpy(file->last_modified, job->last_modified, LAST_MODIFIED_SIZE);
+    return file;
+}
+
+static void run_job(struct compress_job *job)
+{
+    size_t size;
+    size_t compressed;
+    char *data = read_file(job, &size);
+    char *body = data ? gzip_data(data, size, &compressed) : NULL;
+    free(data);
+
+    job->file = body ? make_file(job, body, compressed) : NULL;
+    compress_cache_deliver(job->cache, job);
+}
+
+static struct compress_job *take_job(void)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->queue && !pool->stopping)
+        pthread_cond_wait(&pool->wakeup, &pool->lock);
+
+    struct compress_job *job = pool->queue;
+    if (job)
+    {
+        pool->queue = job->next;
+        if (!pool->queue)
+            pool->queue_tail = NULL;
+        pool->queued--;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return job;
+}
+
+static void *compress_jobs(void *arg)
+{
+    (void)arg;
+    struct compress_job *job;
+    while ((job = take_job()))
+        run_job(job);
+    return NULL;
+}
+
+bool compress_submit(struct compress_job *job)
+{
+    if (!pool)
+        return false;
+
+    pthread_mutex_lock(&pool->lock);
+    bool queued = !pool->stopping && pool->queued < QUEUE_MAX;
+    if (queued)
+    {
+        job->next = NULL;
+        if (pool->queue_tail)
+            pool->queue_tail->next = job;
+        else
+            pool->queue = job;
+        pool->queue_tail = job;
+        pool->queued++;
+        pthread_cond_signal(&pool->wakeup);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return queued;
+}
+
+// Stop and join the first count threads, handing back the queued jobs
+static void stop_threads(unsigned count)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->wakeup);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (unsigned i = 0; i < count; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    while (pool->queue)
+    {
+        struct compress_job *job = pool->queue;
+        pool->queue = job->next;
+        job->file = NULL;
+        compress_cache_deliver(job->cache, job);
+    }
+}
+
+static void free_pool(void)
+{
+    pthread_cond_destroy(&pool->wakeup);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool);
+    pool = NULL;
+}
+
+bool compress_init(const struct config *config)
+{
+    pool = calloc(1, sizeof(struct compress_pool));
+    if (!pool)
+        return false;
+    pool->threads = calloc(config->compress_threads, sizeof(pthread_t));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wakeup, NULL);
+
+    unsigned started = 0;
+    while (pool->threads && started < config->compress_threads
+           && !pthread_create(&pool->threads[started], NULL, compress_jobs,
+                              NULL))
+        started++;
+
+    if (started < config->compress_threads)
+    {
+        stop_threads(started);
+        free_pool();
+        return false;
+    }
+    pool->thread_count = started;
+    return true;
+}
+
+void compress_destroy(void)
+{
+    if (!pool)
+        return;
+
+    stop_threads(pool->thread_count);
+    free_pool();
+}
@@ -0,0 +1,66 @@
+#ifndef COMPRESSOR_H
+#define COMPRESSOR_H
+
+#include <stdbool.h>
+#include <time.h>
+
+#include "../config/config.h"
+#include "../http/http.h"
+#include "../utils/file/file_cache.h"
+
+// Mask of the codings files can be compressed with on the fly
+#define COMPRESSOR_CODINGS (1u << CODING_GZIP)
+
+struct compress_cache;
+
+/*
+** @brief Compression of a file asked for by a worker's cache, handed back
+**        to it once done
+**
+** @param path Path of the file
+** @param mtime Modification time the file must still have, it is not
+**        compressed otherwise
+** @param etag Entity tag of the file, the coding is added to it
+** @param file Compressed file, NULL if the file changed, could not be read
+**        or did not get smaller
+*/
+struct compress_job
+{
+    struct compress_job *next;
+    struct compress_cache *cache;
+    char *path;
+    struct timespec mtime;
+    char etag[ETAG_SIZE];
+    char last_modified[LAST_MODIFIED_SIZE];
+    enum content_coding coding;
+    struct cached_file *file;
+};
+
+/*
+** @brief Start the threads compressing files for every worker
+**
+** @return true on success, compress_submit fails until then
+*/
+bool compress_init(const struct config *config);
+
+/*
+** @brief Stop the compressing threads, jobs still queued are handed back
+**        without a file
+*/
+void compress_destroy(void);
+
+/*
+** @brief Queue job for the compressing threads, which give it to
+**        compress_cache_deliver once done. Never blocks
+**
+** @return false if the threads are not running or too many jobs are queued
+*/
+bool compress_submit(struct compress_job *job);
+
+/*
+** @brief Tell whether a file is worth compressing from its extension, files
+**        like images are already compressed
+*/
+bool compressible(const char *path);
+
+#endif /* ! COMPRESSOR_H */
@@ -3,9 +3,11 @@
 #include "config.h"
 
 #include <getopt.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "../utils/string/string.h"
 
@@ -14,18 +16,34 @@ enum opt
     PID_FILE,
     LOG_FILE,
     LOG,
+    LOG_BUFFER,
+    LOG_OVERFLOW,
+    ACCESS_LOG,
+    METRICS_PATH,
     SERVER_NAME,
     PORT,
     IP,
     ROOT_DIR,
     DEFAULT_FILE,
+    KEEP_ALIVE_TIMEOUT,
+    MAX_REQUESTS,
+    WORKERS,
+    EVENT_ENGINE,
+    FILE_CACHE,
+    FILE_CACHE_MEMORY,
+    FILE_CACHE_MAX_BODY,
+    MAX_CONNECTIONS,
+    TCP_NOPUSH,
+    PRECOMPRESSED,
+    COMPRESS_CACHE,
+    COMPRESS_THREADS,
     DAEMON,
     HELP
 };
 
 static bool display_help = false;
 
-static bool handle_daemon(struct config *config, char *arg)
+static bool handle_daemon(struct config *config, const char *arg)
 {
     if (!strcmp("start", arg))
     {
@@ -46,6 +64,95 @@ static bool handle_daemon(struct config *config, char *arg)
     return false;
 }
 
+static bool handle_event_engine(struct config *config, const char *arg)
+{
+    if (!strcmp("epoll", arg))
+    {
+        config->event_engine = EPOLL_ENGINE;
+        return true;
+    }
+    if (!strcmp("io_uring", arg))
+    {
+        config->event_engine = IO_URING_ENGINE;
+        return true;
+    }
+
+    return false;
+}
+
+static bool handle_log_overflow(struct config *config, const char *arg)
+{
+    if (!strcmp("drop", arg))
+    {
+        config->log_overflow = LOG_OVERFLOW_DROP;
+        return true;
+    }
+    if (!strcmp("block", arg))
+    {
+        config->log_overflow = LOG_OVERFLOW_BLOCK;
+        return true;
+    }
+
+    return false;
+}
+
+static bool handle_choice(struct config *config, int opt, const char *arg)
+{
+    if (opt == DAEMON)
+        return handle_daemon(config, arg);
+    if (opt == LOG_OVERFLOW)
+        return handle_log_overflow(config, arg);
+
+    return handle_event_engine(config, arg);
+}
+
+static bool parse_unsigned(const char *arg, unsigned *value)
+{
+    char *end = NULL;
+    unsigned long parsed = strtoul(arg, &end, 10);
+
+    // Reject empty, negative, trailing garbage and overflowing values
+    if (*arg == '\0' || *arg == '-' || *end != '\0' || parsed > UINT_MAX)
+        return false;
+
+    *value = parsed;
+    return true;
+}
+
+static bool handle_limit(struct config *config, int opt, const char *arg)
+{
+    if (opt == KEEP_ALIVE_TIMEOUT)
+        return parse_unsigned(arg, &config->keep_alive_timeout);
+    if (opt == MAX_REQUESTS)
+        return parse_unsigned(arg, &config->max_requests);
+    if (opt == FILE_CACHE)
+        return parse_unsigned(arg, &config->file_cache);
+    if (opt == FILE_CACHE_MEMORY)
+        return parse_unsigned(arg, &config->file_cache_memory);
+    if (opt == FILE_CACHE_MAX_BODY)
+        return parse_unsigned(arg, &config->file_cache_max_body);
+    if (opt == MAX_CONNECTIONS)
+        return parse_unsigned(arg, &config->max_connections);
+    if (opt == LOG_BUFFER)
+        return parse_unsigned(arg, &config->log_buffer);
+    if (opt == COMPRESS_CACHE)
+        return parse_unsigned(arg, &config->compress_cache);
+    if (opt == COMPRESS_THREADS)
+        return parse_unsigned(arg, &config->compress_threads)
+            && config->compress_threads;
+
+    // Use one worker per online CPU when 0 is given
+    if (!parse_unsigned(arg, &config->workers))
+        return false;
+    if (config->workers == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        config->workers = cpus > 0 ? cpus : 1;
+    }
+
+    return true;
+}
+
 static bool parse_options(int argc, char **argv, struct option *options,
                           struct config *config)
 {
@@ -60,9 +167,21 @@ static bool parse_options(int argc, char **argv, struct option *options,
         case LOG_FILE:
             config->log_file = strdup(optarg);
             break;
+        case ACCESS_LOG:
+            config->access_log = strdup(optarg);
+            break;
+        case METRICS_PATH:
+            config->metrics_path = strdup(optarg);
+            break;
         case LOG:
             config->log = strcmp("true", optarg) == 0;
             break;
+        case TCP_NOPUSH:
+            config->tcp_nopush = strcmp("true", optarg) == 0;
+            break;
+        case PRECOMPRESSED:
+            config->precompressed = strcmp("true", optarg) == 0;
+            break;
         case SERVER_NAME:
             config->servers->server_name =
                 string_create(optarg, strlen(optarg));
@@ -79,8 +198,23 @@ static bool parse_options(int argc, char **argv, struct option *options,
         case DEFAULT_FILE:
             config->servers->default_file = strdup(optarg);
             break;
+        case KEEP_ALIVE_TIMEOUT:
+        case MAX_REQUESTS:
+        case WORKERS:
+        case FILE_CACHE:
+        case FILE_CACHE_MEMORY:
+        case FILE_CACHE_MAX_BODY:
+        case MAX_CONNECTIONS:
+        case LOG_BUFFER:
+        case COMPRESS_CACHE:
+        case COMPRESS_THREADS:
+            if (!handle_limit(config, c, optarg))
+                return false;
+            break;
+        case EVENT_ENGINE:
+        case LOG_OVERFLOW:
         case DAEMON:
-            if (!handle_daemon(config, optarg))
+            if (!handle_choice(config, c, optarg))
                 return false;
             break;
         case HELP:
@@ -103,18 +237,47 @@ struct config *parse_configuration(int argc, char *argv[], bool *help_requested)
         { "pid_file", required_argument, NULL, PID_FILE },
         { "log_file", required_argument, NULL, LOG_FILE },
         { "log", required_argument, NULL, LOG },
+        { "log_buffer", required_argument, NULL, LOG_BUFFER },
+        { "log_overflow", required_argument, NULL, LOG_OVERFLOW },
+        { "access_log", required_argument, NULL, ACCESS_LOG },
+        { "metrics_path", required_argument, NULL, METRICS_PATH },
         { "server_name", required_argument, NULL, SERVER_NAME },
         { "port", required_argument, NULL, PORT },
         { "ip", required_argument, NULL, IP },
         { "root_dir", required_argument, NULL, ROOT_DIR },
         { "default_file", required_argument, NULL, DEFAULT_FILE },
+        { "keep_alive_timeout", required_argument, NULL,
+          KEEP_ALIVE_TIMEOUT },
+        { "max_requests", required_argument, NULL, MAX_REQUESTS },
+        { "workers", required_argument, NULL, WORKERS },
+        { "event_engine", required_argument, NULL, EVENT_ENGINE },
+        { "file_cache", required_argument, NULL, FILE_CACHE },
+        { "file_cache_memory", required_argument, NULL, FILE_CACHE_MEMORY },
+        { "file_cache_max_body", required_argument, NULL,
+          FILE_CACHE_MAX_BODY },
+        { "max_connections", required_argument, NULL, MAX_CONNECTIONS },
+        { "tcp_nopush", required_argument, NULL, TCP_NOPUSH },
+        { "precompressed", required_argument, NULL, PRECOMPRESSED },
+        { "compress_cache", required_argument, NULL, COMPRESS_CACHE },
+        { "compress_threads", required_argument, NULL, COMPRESS_THREADS },
         { "daemon", required_argument, NULL, DAEMON },
-        { "help", no_argument, NULL, HELP }
+        { "help", no_argument, NULL, HELP },
+        { NULL, 0, NULL, 0 }
     };
 
     struct config *config = calloc(1, sizeof(struct config));
     config->servers = calloc(1, sizeof(struct server_config));
     config->log = true;
+    config->log_buffer = DEFAULT_LOG_BUFFER;
+    config->keep_alive_timeout = DEFAULT_KEEP_ALIVE_TIMEOUT;
+    config->max_requests = DEFAULT_MAX_REQUESTS;
+    config->workers = DEFAULT_WORKERS;
+    config->file_cache = DEFAULT_FILE_CACHE;
+    config->file_cache_memory = DEFAULT_FILE_CACHE_MEMORY;
+    config->file_cache_max_body = DEFAULT_FILE_CACHE_MAX_BODY;
+    config->max_connections = DEFAULT_MAX_CONNECTIONS;
+    config->tcp_nopush = true;
+    config->compress_threads = DEFAULT_COMPRESS_THREADS;
 
     if (!parse_options(argc, argv, options, config) || !config->pid_file
         || !config->servers->server_name || !config->servers->port
@@ -137,6 +300,8 @@ void config_destroy(struct config *config)
 {
     free(config->pid_file);
     free(config->log_file);
+    free(config->access_log);
+    free(config->metrics_path);
     string_destroy(config->servers->server_name);
     free(config->servers->port);
     free(config->servers->ip);
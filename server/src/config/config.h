@@ -1,10 +1,22 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
-#define _XOPEN_SOURCE 500
+#ifndef _XOPEN_SOURCE
+#    define _XOPEN_SOURCE 500
+#endif
 
 #include <stdbool.h>
 
+#define DEFAULT_KEEP_ALIVE_TIMEOUT 5
+#define DEFAULT_MAX_REQUESTS 100
+#define DEFAULT_WORKERS 1
+#define DEFAULT_FILE_CACHE 128
+#define DEFAULT_FILE_CACHE_MEMORY (8 * 1024 * 1024)
+#define DEFAULT_FILE_CACHE_MAX_BODY (16 * 1024)
+#define DEFAULT_MAX_CONNECTIONS 1024
+#define DEFAULT_LOG_BUFFER 1024
+#define DEFAULT_COMPRESS_THREADS 1
+
 /*
 ** @brief Enum daemon
 ** NO_OPTION if the '--daemon' option is not given
@@ -18,12 +30,65 @@ enum daemon
     RESTART
 };
 
+/*
+** @brief Enum event_engine
+** EPOLL_ENGINE readiness based event loop, available everywhere
+** IO_URING_ENGINE completion based event loop, falls back to epoll when the
+** kernel does not support it
+*/
+enum event_engine
+{
+    EPOLL_ENGINE = 0,
+    IO_URING_ENGINE
+};
+
+/*
+** @brief Enum log_overflow
+** LOG_OVERFLOW_DROP lines logged while the log buffer is full are dropped and
+** counted
+** LOG_OVERFLOW_BLOCK workers wait for room in the log buffer
+*/
+enum log_overflow
+{
+    LOG_OVERFLOW_DROP = 0,
+    LOG_OVERFLOW_BLOCK
+};
+
 /*
 ** @brief Configuration structure
 **
 ** @param pid_file Path to the pid file
 ** @param log_file Path to the log file
 ** @param log Enable or disable logging
+** @param log_buffer Lines buffered for the logging thread, 0 makes workers
+**        write their lines themselves
+** @param log_overflow What workers do when the log buffer is full
+** @param access_log Path to the binary access log, NULL to log requests as
+**        text lines
+** @param metrics_path Target answered with the metrics of the server, NULL
+**        disables the metrics
+** @param keep_alive_timeout Seconds an idle connection is kept open, 0
+**        disables persistent connections
+** @param max_requests Requests served on one connection before closing it,
+**        0 means unlimited
+** @param workers Number of event loop threads, each with its own listening
+**        socket
+** @param event_engine Event loop used by the workers
+** @param file_cache Number of open files each worker keeps cached, 0
+**        disables the cache
+** @param file_cache_memory Bytes of small file bodies each worker keeps in
+**        memory
+** @param file_cache_max_body Size up to which a cached file body is kept in
+**        memory
+** @param max_connections Connections each worker keeps open at once, 0
+**        means unlimited
+** @param tcp_nopush Send a header along with the start of the file body
+**        following it instead of in a segment of its own
+** @param precompressed Serve the .br, .zst or .gz file next to a file
+**        when the client accepts its coding
+** @param compress_cache Bytes of compressed files each worker keeps in
+**        memory, 0 disables compressing responses
+** @param compress_threads Threads compressing files for every worker
 ** @param servers Array of vhosts
 ** @daemon option for the daemon (START, STOP, RESTART)
 */
@@ -32,6 +97,22 @@ struct config
     char *pid_file;
     char *log_file;
     bool log;
+    unsigned log_buffer;
+    enum log_overflow log_overflow;
+    char *access_log;
+    char *metrics_path;
+    unsigned keep_alive_timeout;
+    unsigned max_requests;
+    unsigned workers;
+    enum event_engine event_engine;
+    unsigned file_cache;
+    unsigned file_cache_memory;
+    unsigned file_cache_max_body;
+    unsigned max_connections;
+    bool tcp_nopush;
+    bool precompressed;
+    unsigned compress_cache;
+    unsigned compress_threads;
 
     struct server_config *servers;
     enum daemon daemon;
@@ -0,0 +1,147 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "http.h"
+
+static const char *const months[] = { "Jan", "Feb", "Mar", "Apr",
+                                      "May", "Jun", "Jul", "Aug",
+                                      "Sep", "Oct", "Nov", "Dec" };
+
+static bool parse_digits(const char *data, size_t count, int *value)
+{
+    *value = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (data[i] < '0' || data[i] > '9')
+            return false;
+        *value = *value * 10 + data[i] - '0';
+    }
+    return true;
+}
+
+static int parse_month(const char *data)
+{
+    for (int i = 0; i < 12; i++)
+        if (!memcmp(data, months[i], 3))
+            return i + 1;
+    return 0;
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date, without timegm
+static long days_from_civil(int year, int month, int day)
+{
+    year -= month <= 2;
+    long era = (year >= 0 ? year : year - 399) / 400;
+    long year_of_era = year - era * 400;
+    long day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long day_of_era =
+        year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+/*
+** @brief Parse an IMF-fixdate, "Sun, 06 Nov 1994 08:49:37 GMT". The
+**        obsolete formats are not accepted, the field is then ignored
+*/
+static bool parse_http_date(const struct string *value, time_t *date)
+{
+    const char *data = value->data;
+    if (value->size != HTTP_DATE_SIZE || memcmp(data + 3, ", ", 2)
+        || data[7] != ' ' || data[11] != ' ' || data[16] != ' '
+        || data[19] != ':' || data[22] != ':' || memcmp(data + 25, " GMT", 4))
+        return false;
+
+    int day;
+    int year;
+    int hour;
+    int minute;
+    int second;
+    int month = parse_month(data + 8);
+    if (!month || !parse_digits(data + 5, 2, &day)
+        || !parse_digits(data + 12, 4, &year)
+        || !parse_digits(data + 17, 2, &hour)
+        || !parse_digits(data + 20, 2, &minute)
+        || !parse_digits(data + 23, 2, &second) || day < 1 || day > 31
+        || hour > 23 || minute > 59 || second > 60)
+        return false;
+
+    *date = (time_t)days_from_civil(year, month, day) * 86400 + hour * 3600
+        + minute * 60 + second;
+    return true;
+}
+
+/*
+** @brief Look for etag in a list of entity tags with the weak comparison,
+**        W/ prefixes are ignored. "*" matches any current representation
+*/
+static bool etag_listed(const struct string *list, const char *etag)
+{
+    size_t etag_size = strlen(etag);
+    size_t i = 0;
+    while (i < list->size)
+    {
+        const char *data = list->data;
+        if (data[i] == ' ' || data[i] == '\t' || data[i] == ',')
+        {
+            i++;
+            continue;
+        }
+        if (data[i] == '*')
+            return true;
+        if (list->size - i > 2 && !memcmp(data + i, "W/", 2))
+            i += 2;
+
+        // Opaque tag, quotes included
+        size_t start = i;
+        const char *quote = data[i] == '"'
+            ? memchr(data + i + 1, '"', list->size - i - 1)
+            : NULL;
+        if (!quote)
+            return false;
+        i = quote + 1 - data;
+        if (i - start == etag_size && !memcmp(data + start, etag, etag_size))
+            return true;
+    }
+    return false;
+}
+
+bool request_not_modified(const struct request_header *req_header,
+                          const char *etag, time_t mtime)
+{
+    // If-Modified-Since is ignored when If-None-Match is present, every
+    // If-None-Match field adds to the list
+    bool none_match = false;
+    for (size_t i = 0; i < req_header->field_count; i++)
+    {
+        const struct http_field *field = &req_header->fields[i];
+        if (field->id != FIELD_IF_NONE_MATCH)
+            continue;
+        if (etag && etag_listed(&field->value, etag))
+            return true;
+        none_match = true;
+    }
+    if (none_match)
+        return false;
+
+    const struct string *since =
+        get_request_field(req_header, FIELD_IF_MODIFIED_SINCE);
+    time_t date;
+    return since && parse_http_date(since, &date) && mtime <= date;
+}
+
+bool range_applies(const struct request_header *req_header, const char *etag,
+                   time_t mtime)
+{
+    const struct string *if_range =
+        get_request_field(req_header, FIELD_IF_RANGE);
+    if (!if_range)
+        return true;
+
+    // Entity tags are compared strongly here, weak ones never match
+    time_t date;
+    if (if_range->size && if_range->data[0] == '"')
+        return etag && strlen(etag) == if_range->size
+            && !memcmp(if_range->data, etag, if_range->size);
+    return parse_http_date(if_range, &date) && date == mtime;
+}
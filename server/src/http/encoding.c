@@ -0,0 +1,151 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "../utils/string/string.h"
+#include "http.h"
+
+// Weight of a coding Accept-Encoding does not list, q values are kept in
+// thousandths
+#define WEIGHT_UNLISTED -1
+#define WEIGHT_MAX 1000
+
+const char *const coding_names[CODING_COUNT] = { "br", "zstd", "gzip" };
+const char *const coding_suffixes[CODING_COUNT + 1] = { ".br", ".zst", ".gz",
+                                                        NULL };
+
+/*
+** @brief Weights given by Accept-Encoding
+**
+** @param any Weight of "*", for the codings not listed
+** @param identity Weight of "identity", sending the file as is
+*/
+struct coding_weights
+{
+    int codings[CODING_COUNT];
+    int any;
+    int identity;
+};
+
+static bool is_blank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+// qvalue = ( "0" [ "." 0*3DIGIT ] ) / ( "1" [ "." 0*3("0") ] )
+static int parse_qvalue(const char *data, size_t size)
+{
+    if (!size || (data[0] != '0' && data[0] != '1')
+        || (size > 1 && (data[1] != '.' || size > 5)))
+        return WEIGHT_UNLISTED;
+
+    int weight = (data[0] - '0') * WEIGHT_MAX;
+    int scale = WEIGHT_MAX / 10;
+    for (size_t i = 2; i < size; i++, scale /= 10)
+    {
+        if (data[i] < '0' || data[i] > '9')
+            return WEIGHT_UNLISTED;
+        weight += (data[i] - '0') * scale;
+    }
+    return weight <= WEIGHT_MAX ? weight : WEIGHT_UNLISTED;
+}
+
+// Weight of an element's parameters, ";q=0.5", WEIGHT_UNLISTED if invalid
+static int parse_weight(const char *data, size_t size)
+{
+    size_t i = 0;
+    while (i < size && is_blank(data[i]))
+        i++;
+    if (i == size)
+        return WEIGHT_MAX;
+    if (data[i++] != ';')
+        return WEIGHT_UNLISTED;
+
+    while (i < size && is_blank(data[i]))
+        i++;
+    if (size - i < 2 || !string_n_casecmp(data + i, "q=", 2))
+        return WEIGHT_UNLISTED;
+
+    size_t end = size;
+    while (end > i + 2 && is_blank(data[end - 1]))
+        end--;
+    return parse_qvalue(data + i + 2, end - i - 2);
+}
+
+static void weigh_element(struct coding_weights *weights, const char *data,
+                          size_t size)
+{
+    size_t name_size = 0;
+    while (name_size < size && data[name_size] != ';'
+           && !is_blank(data[name_size]))
+        name_size++;
+    int weight = parse_weight(data + name_size, size - name_size);
+    if (!name_size || weight == WEIGHT_UNLISTED)
+        return;
+
+    if (name_size == 1 && data[0] == '*')
+        weights->any = weight;
+    if (name_size == 8 && string_n_casecmp(data, "identity", 8))
+        weights->identity = weight;
+    if (name_size == 6 && string_n_casecmp(data, "x-gzip", 6))
+        weights->codings[CODING_GZIP] = weight;
+    for (int c = 0; c < CODING_COUNT; c++)
+        if (name_size == strlen(coding_names[c])
+            && string_n_casecmp(data, coding_names[c], name_size))
+            weights->codings[c] = weight;
+}
+
+static void weigh_field(struct coding_weights *weights,
+                        const struct string *value)
+{
+    size_t start = 0;
+    while (start < value->size)
+    {
+        const char *comma =
+            memchr(value->data + start, ',', value->size - start);
+        size_t end = comma ? (size_t)(comma - value->data) : value->size;
+        while (start < end && is_blank(value->data[start]))
+            start++;
+
+        weigh_element(weights, value->data + start, end - start);
+        start = end + 1;
+    }
+}
+
+enum content_coding negotiate_coding(const struct request_header *req_header,
+                                     unsigned available)
+{
+    struct coding_weights weights = { .any = WEIGHT_UNLISTED,
+                                      .identity = WEIGHT_UNLISTED };
+    for (int c = 0; c < CODING_COUNT; c++)
+        weights.codings[c] = WEIGHT_UNLISTED;
+
+    // Every Accept-Encoding field adds to the list
+    for (size_t i = 0; i < req_header->field_count; i++)
+        if (req_header->fields[i].id == FIELD_ACCEPT_ENCODING)
+            weigh_field(&weights, &req_header->fields[i].value);
+
+    enum content_coding best = CODING_IDENTITY;
+    int best_weight = 0;
+    for (int c = 0; c < CODING_COUNT; c++)
+    {
+        int weight = weights.codings[c] != WEIGHT_UNLISTED
+            ? weights.codings[c]
+            : weights.any;
+        if ((available & (1u << c)) && weight > best_weight)
+        {
+            best = c;
+            best_weight = weight;
+        }
+    }
+
+    // Identity is preferred when weighted as much as the best coding, or
+    // more through "*". Unlisted, it never wins over a listed coding
+    if (weights.identity != WEIGHT_UNLISTED
+            ? weights.identity >= best_weight
+            : weights.any > best_weight)
+        return CODING_IDENTITY;
+    return best;
+}
@@ -1,12 +1,18 @@
 #ifndef HTTP_H
 #define HTTP_H
 
+#include <limits.h>
+#include <stdbool.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <time.h>
 
 #include "../config/config.h"
+#include "../utils/arena/arena.h"
 #include "../utils/string/string.h"
 
 #define HTTP_VERSION "HTTP/1.1"
+#define HTTP_VERSION_1_0 "HTTP/1.0"
 
 enum http_method
 {
@@ -18,41 +24,383 @@ enum http_method
 enum request_status
 {
     OK = 200,
+    PARTIAL_CONTENT = 206,
+    NOT_MODIFIED = 304,
     BAD_REQUEST = 400,
     FORBIDDEN = 403,
     NOT_FOUND = 404,
     METHOD_NOT_ALLOWED = 405,
+    URI_TOO_LONG = 414,
+    RANGE_NOT_SATISFIABLE = 416,
     UNSUPPORTED_VERSION = 505
 };
 
+// Largest request header accepted, bigger ones are rejected before they are
+// fully received
+#define REQUEST_HEADER_MAX 8192
+
+enum parse_state
+{
+    STATE_START,
+    STATE_METHOD,
+    STATE_TARGET_START,
+    STATE_TARGET,
+    STATE_VERSION,
+    STATE_REQUEST_LINE_LF,
+    STATE_FIELD_START,
+    STATE_FIELD_NAME,
+    STATE_FIELD_VALUE,
+    STATE_FIELD_LF,
+    STATE_HEADER_END_LF,
+    STATE_COMPLETE,
+    STATE_ERROR
+};
+
+/*
+** @brief Result of feeding received data to the parser
+** PARSE_NEED_MORE the header is valid so far but not complete
+** PARSE_COMPLETE the header is complete, http_parser_finish can be called
+** PARSE_ERROR the data cannot be the start of a valid request
+*/
+enum parse_result
+{
+    PARSE_NEED_MORE,
+    PARSE_COMPLETE,
+    PARSE_ERROR
+};
+
+// Most fields kept per request, requests with more are rejected
+#define HEADER_FIELDS_MAX 64
+
+/*
+** @brief Fields the server knows by name, any other one is FIELD_OTHER
+*/
+enum header_field
+{
+    FIELD_OTHER,
+    FIELD_HOST,
+    FIELD_CONNECTION,
+    FIELD_CONTENT_LENGTH,
+    FIELD_TRANSFER_ENCODING,
+    FIELD_EXPECT,
+    FIELD_IF_NONE_MATCH,
+    FIELD_IF_MODIFIED_SINCE,
+    FIELD_IF_RANGE,
+    FIELD_RANGE,
+    FIELD_ACCEPT,
+    FIELD_ACCEPT_ENCODING,
+    FIELD_USER_AGENT,
+    FIELD_REFERER,
+    FIELD_COOKIE,
+    FIELD_COUNT
+};
+
+enum connection_option
+{
+    CONNECTION_DEFAULT = 0,
+    CONNECTION_CLOSE,
+    CONNECTION_KEEP_ALIVE
+};
+
+/*
+** @brief Name and value of a received field, as offsets from the first byte
+**        of the request. The value excludes leading and trailing blanks
+*/
+struct field_offsets
+{
+    enum header_field id;
+    size_t name_start;
+    size_t name_end;
+    size_t value_start;
+    size_t value_end;
+};
+
+/*
+** @brief Resumable request parser. Every offset is relative to the first
+**        byte of the request so the buffer can grow or move between reads
+**
+** @param state Current state of the state machine
+** @param position Offset of the next byte to parse
+** @param version_index Number of "HTTP/x.x" characters matched
+** @param in_value A non blank character of the current field value was seen
+** @param connection Option given by the last Connection field
+** @param fields Received fields, the one being parsed is at field_count
+*/
+struct http_parser
+{
+    enum parse_state state;
+    size_t position;
+
+    size_t method_start;
+    size_t method_end;
+    size_t target_start;
+    size_t target_end;
+    size_t version_start;
+    unsigned version_index;
+
+    size_t value_start;
+    size_t value_end;
+    bool in_value;
+    enum connection_option connection;
+
+    // Left uninitialized by http_parser_init, only the first field_count
+    // entries are meaningful
+    size_t field_count;
+    struct field_offsets fields[HEADER_FIELDS_MAX];
+};
+
+/*
+** @brief Received field, name and value point into the parsed buffer
+*/
+struct http_field
+{
+    enum header_field id;
+    struct string name;
+    struct string value;
+};
+
+/*
+** @brief Parsed request. target, version, host and fields point into the
+**        parsed buffer and are only valid as long as it is, host.data is NULL
+**        when the field is missing
+**
+** @param has_body The request declares a body. Bodies are never read, the
+**        bytes after the header cannot be told apart from the next request
+** @param filename Path of the requested file under the root directory
+** @param fields Every received field, in order
+** @param known Index + 1 in fields of the first field of each known name, 0
+**        when it was not received
+*/
 struct request_header
 {
     enum http_method method;
     enum request_status status;
-    struct string *filename;
-    struct string *target;
-    struct string *version;
-    struct string *host;
+    struct string target;
+    struct string version;
+    struct string host;
+    bool keep_alive;
+    bool has_body;
+    char filename[PATH_MAX];
+
+    size_t field_count;
+    struct http_field fields[HEADER_FIELDS_MAX];
+    unsigned char known[FIELD_COUNT];
 };
 
+// Length of an IMF-fixdate, "Sun, 06 Nov 1994 08:49:37 GMT"
+#define HTTP_DATE_SIZE 29
+
+/*
+** @brief Value of the Date field, formatted once per second instead of once
+**        per response. Each event loop owns one
+**
+** @param time Second value was formatted for
+** @param value View of buffer
+*/
+struct http_date
+{
+    time_t time;
+    char buffer[HTTP_DATE_SIZE + 1];
+    struct string value;
+};
+
+/*
+** @brief Encodings files can be precompressed with, from the most to the
+**        least preferred. Bit c of a mask of codings stands for coding c
+*/
+enum content_coding
+{
+    CODING_BR,
+    CODING_ZSTD,
+    CODING_GZIP,
+    CODING_COUNT,
+    CODING_IDENTITY = CODING_COUNT
+};
+
+// Names of the codings in Accept-Encoding and Content-Encoding
+extern const char *const coding_names[CODING_COUNT];
+// Suffixes of the precompressed siblings of a file, NULL terminated
+extern const char *const coding_suffixes[CODING_COUNT + 1];
+
+// Most ranges served for one request, Range fields with more are ignored
+#define RANGES_MAX 16
+
+/*
+** @brief Satisfiable range of bytes of a file, length is never 0
+*/
+struct byte_range
+{
+    off_t start;
+    off_t length;
+};
+
+/*
+** @brief Response to a request, allocated in an arena
+**
+** @param status Status line, without its line ending
+** @param date Value of the Date field
+** @param etag Value of the ETag field, NULL to send none
+** @param last_modified Value of the Last-Modified field, NULL to send none
+** @param accept_ranges Advertise byte range support
+** @param ranges Ranges of the file sent by a 206, one part per range
+** @param file_size Size of the file the ranges are taken from, also sent by
+**        a 416
+** @param content_encoding Value of the Content-Encoding field, NULL to send
+**        none
+** @param vary_encoding The file sent was chosen from Accept-Encoding
+*/
 struct response_header
 {
     enum request_status status_code;
-    struct string *status;
-    struct string *date;
+    const struct string *status;
+    const struct string *date;
     off_t content_length;
+    bool keep_alive;
+    const char *etag;
+    const char *last_modified;
+    bool accept_ranges;
+    const struct byte_range *ranges;
+    size_t range_count;
+    off_t file_size;
+    const char *content_encoding;
+    bool vary_encoding;
+};
+
+// Most pieces a serialized response header is made of
+#define HEADER_PARTS_MAX 8
+
+/*
+** @brief Serialized response header, sent as is with a single sendmsg. Lines
+**        shared by many responses point to static strings, only the ones
+**        specific to the response are written in its arena
+**
+** @param size Total number of bytes of the parts
+*/
+struct header_parts
+{
+    struct iovec parts[HEADER_PARTS_MAX];
+    size_t count;
+    size_t size;
 };
 
 // HTTP Request
-struct request_header *parse_request(struct string *request,
-                                     const struct config *config);
-void destroy_request(struct request_header *request);
+void http_parser_init(struct http_parser *parser);
+
+/*
+** @brief Parse the bytes of request not parsed yet. request starts at the
+**        first byte of the request and holds at least as many bytes as the
+**        previous call
+*/
+enum parse_result http_parser_feed(struct http_parser *parser,
+                                   const struct string *request);
+
+/*
+** @brief Fill req_header from a request fed to the parser. Requests the
+**        parser did not complete are answered with BAD_REQUEST
+*/
+void http_parser_finish(const struct http_parser *parser,
+                        struct string *request, const struct config *config,
+                        struct request_header *req_header);
+
+/*
+** @brief Parse a request received at once
+*/
+void parse_request(struct string *request, const struct config *config,
+                   struct request_header *req_header);
+
+/*
+** @brief Get the value of the first field named after field, NULL if the
+**        request has none
+*/
+const struct string *get_request_field(const struct request_header *req_header,
+                                       enum header_field field);
+
+/*
+** @brief Evaluate If-None-Match, or If-Modified-Since when it is absent,
+**        against the file about to be sent
+**
+** @param etag Entity tag of the file, NULL if it has none
+** @param mtime Last modification time of the file
+**
+** @return true when the client's copy is current and 304 can be answered
+*/
+bool request_not_modified(const struct request_header *req_header,
+                          const char *etag, time_t mtime);
+
+/*
+** @brief Evaluate If-Range against the file about to be sent
+**
+** @return true when the Range field applies, always if there is no If-Range
+*/
+bool range_applies(const struct request_header *req_header, const char *etag,
+                   time_t mtime);
+
+/*
+** @brief Choose among the available codings the one Accept-Encoding gives
+**        the highest weight, the most preferred one on ties. Identity wins
+**        when it is given at least that weight
+**
+** @param available Mask of the codings the file is precompressed with
+**
+** @return the coding, CODING_IDENTITY when none is acceptable
+*/
+enum content_coding negotiate_coding(const struct request_header *req_header,
+                                     unsigned available);
+
+/*
+** @brief Parse the value of a Range field against a file of size bytes,
+**        dropping the ranges that cannot be satisfied
+**
+** @param ranges At least RANGES_MAX ranges
+**
+** @return the number of ranges to send, 0 if the field must be ignored
+**         because it is invalid or has too many ranges, -1 if none can be
+**         satisfied
+*/
+int parse_ranges(const struct string *value, off_t size,
+                 struct byte_range *ranges);
 
 // HTTP Response
+/*
+** @brief Format the Date field value for now, unless it already was
+*/
+void http_date_update(struct http_date *date, time_t now);
+
+/*
+** @brief Create the response to request, allocated in arena
+**
+** @param date Value of the Date field, must outlive the response
+**
+** @return the response, NULL if arena ran out of memory
+*/
 struct response_header *create_response(const struct request_header *request,
-                                        off_t content_length);
-struct string *
-response_header_to_string(const struct response_header *response);
-void destroy_response(struct response_header *response);
+                                        off_t content_length,
+                                        const struct http_date *date,
+                                        struct arena *arena);
+
+/*
+** @brief Serialize the header of response in arena
+**
+** @return the header, NULL if arena ran out of memory
+*/
+struct header_parts *
+response_header_to_parts(const struct response_header *response,
+                         struct arena *arena);
+
+/*
+** @brief Length of the multipart/byteranges body of a 206 with several
+**        ranges, delimiters included
+*/
+off_t multipart_length(const struct response_header *response);
+
+/*
+** @brief Serialize in arena the delimiter and fields sent before the part
+**        of range index of a multipart/byteranges body, or the closing
+**        delimiter when index is range_count
+**
+** @return the part header, NULL if arena ran out of memory
+*/
+struct header_parts *multipart_header(const struct response_header *response,
+                                      size_t index, struct arena *arena);
 
 #endif /* ! HTTP_H */
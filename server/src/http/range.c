@@ -0,0 +1,129 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../utils/string/string.h"
+#include "http.h"
+
+// Largest position accepted, longer numbers make the field invalid
+#define POSITION_MAX (INT64_MAX / 10 - 1)
+
+/*
+** @brief Range being read from the value of a Range field
+**
+** @param position Next character to read
+*/
+struct range_reader
+{
+    const char *data;
+    size_t size;
+    size_t position;
+};
+
+static bool read_position(struct range_reader *reader, off_t *value)
+{
+    size_t start = reader->position;
+    *value = 0;
+    while (reader->position < reader->size
+           && reader->data[reader->position] >= '0'
+           && reader->data[reader->position] <= '9')
+    {
+        if (*value > POSITION_MAX)
+            return false;
+        *value = *value * 10 + reader->data[reader->position++] - '0';
+    }
+    return reader->position > start;
+}
+
+static bool read_char(struct range_reader *reader, char c)
+{
+    if (reader->position < reader->size && reader->data[reader->position] == c)
+    {
+        reader->position++;
+        return true;
+    }
+    return false;
+}
+
+static void skip_blanks(struct range_reader *reader)
+{
+    while (read_char(reader, ' ') || read_char(reader, '\t'))
+        continue;
+}
+
+/*
+** @brief Read one range-spec, "first-last", "first-" or "-suffix"
+**
+** @return 1 if range can be sent, 0 if it cannot be satisfied, -1 if the
+**         spec is invalid
+*/
+static int read_spec(struct range_reader *reader, off_t size,
+                     struct byte_range *range)
+{
+    off_t first;
+    off_t last = size - 1;
+    if (read_char(reader, '-'))
+    {
+        off_t suffix;
+        if (!read_position(reader, &suffix))
+            return -1;
+        if (!suffix || !size)
+            return 0;
+        range->length = suffix < size ? suffix : size;
+        range->start = size - range->length;
+        return 1;
+    }
+
+    if (!read_position(reader, &first) || !read_char(reader, '-'))
+        return -1;
+    if (reader->position < reader->size
+        && reader->data[reader->position] >= '0'
+        && reader->data[reader->position] <= '9')
+    {
+        if (!read_position(reader, &last) || last < first)
+            return -1;
+        last = last < size - 1 ? last : size - 1;
+    }
+    if (first >= size)
+        return 0;
+
+    range->start = first;
+    range->length = last - first + 1;
+    return 1;
+}
+
+int parse_ranges(const struct string *value, off_t size,
+                 struct byte_range *ranges)
+{
+    struct range_reader reader = { value->data, value->size, 0 };
+    if (value->size < 6 || !string_n_casecmp(value->data, "bytes=", 6))
+        return 0;
+    reader.position = 6;
+
+    // Empty elements of the list are allowed, ", , 0-1"
+    int count = 0;
+    bool any = false;
+    while (reader.position < reader.size)
+    {
+        skip_blanks(&reader);
+        if (read_char(&reader, ','))
+            continue;
+
+        struct byte_range range;
+        int result = read_spec(&reader, size, &range);
+        skip_blanks(&reader);
+        if (result < 0
+            || (reader.position < reader.size && !read_char(&reader, ','))
+            || (result && count == RANGES_MAX))
+            return 0;
+        if (result)
+            ranges[count++] = range;
+        any = true;
+    }
+
+    if (!any)
+        return 0;
+    return count ? count : -1;
+}
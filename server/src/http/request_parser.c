@@ -1,231 +1,342 @@
 #include <ctype.h>
 #include <stdbool.h>
 #include <stddef.h>
-#include <stdlib.h>
 #include <string.h>
 
 #include "../config/config.h"
 #include "../utils/string/string.h"
 #include "http.h"
+#include "scan.h"
 
-static enum http_method get_method(const char *data, size_t size)
+static enum parse_state error(struct http_parser *parser)
 {
-    if (size >= 3 && !memcmp(data, "GET", 3))
-        return GET;
-    if (size >= 4 && !memcmp(data, "HEAD", 4))
-        return HEAD;
-
-    return UNKNOWN;
+    parser->state = STATE_ERROR;
+    return STATE_ERROR;
 }
 
-static size_t get_filename_length(const char *data, size_t size, size_t start)
+static enum parse_state step_version(struct http_parser *parser, char c)
 {
-    size_t i = start;
-
-    // Traverse file name
-    while (i < size && data[i] != ' ')
-        i++;
-
-    if (i == size)
-        return 0;
+    static const char pattern[] = "HTTP/x.x";
+    unsigned index = parser->version_index++;
 
-    return i - start;
-}
+    // Version is complete, request line must end right after it
+    if (index == sizeof(pattern) - 1)
+        return c == '\r' ? STATE_REQUEST_LINE_LF : error(parser);
 
-static bool end_of_header(struct string *request, size_t index)
-{
-    return request->data[index] == '\r' && request->data[index + 1] == '\n';
+    bool valid = pattern[index] == 'x' ? isdigit((unsigned char)c)
+                                       : c == pattern[index];
+    return valid ? STATE_VERSION : error(parser);
 }
 
-static bool is_valid_field_name_char(char c)
+static enum parse_state step_request_line(struct http_parser *parser,
+                                          size_t i, char c)
 {
-    if (isalnum(c))
-        return true;
-
-    switch (c)
+    switch (parser->state)
     {
-    case '!':
-    case '#':
-    case '$':
-    case '%':
-    case '&':
-    case '\'':
-    case '*':
-    case '+':
-    case '-':
-    case '.':
-    case '^':
-    case '_':
-    case '`':
-    case '|':
-    case '~':
-        return true;
+    case STATE_START:
+        // Ignore empty lines before the request line
+        if (c == '\r' || c == '\n')
+            return STATE_START;
+        parser->method_start = i;
+        return is_token_char(c) ? STATE_METHOD : error(parser);
+    case STATE_METHOD:
+        if (is_token_char(c))
+            return STATE_METHOD;
+        parser->method_end = i;
+        return c == ' ' ? STATE_TARGET_START : error(parser);
+    case STATE_TARGET_START:
+        parser->target_start = i;
+        return is_visible_char(c) ? STATE_TARGET : error(parser);
+    case STATE_TARGET:
+        if (is_visible_char(c))
+            return STATE_TARGET;
+        parser->target_end = i;
+        parser->version_start = i + 1;
+        return c == ' ' ? STATE_VERSION : error(parser);
+    case STATE_VERSION:
+        return step_version(parser, c);
     default:
-        return false;
+        return c == '\n' ? STATE_FIELD_START : error(parser);
     }
 }
 
-static bool is_valid_header_line(struct string *request, size_t index)
+/*
+** @brief Known field names indexed by their hash, the hash is the name length
+**        plus 6 times its lowercased second character, modulo 32. It was
+**        searched for to map every name to its own slot, check it still does
+**        when adding one
+*/
+#define FIELD_HASH_SIZE 32
+
+static const struct
 {
-    char *data = request->data;
-    // A valid header line must contain a colon ':'
-    while (index + 1 < request->size
-           && !(data[index] == '\r' && data[index + 1] == '\n')
-           && is_valid_field_name_char(data[index]))
-    {
-        index++;
-    }
+    const char *name;
+    size_t size;
+    enum header_field id;
+} known_fields[FIELD_HASH_SIZE] = {
+    [0] = { "cookie", 6, FIELD_COOKIE },
+    [1] = { "accept-encoding", 15, FIELD_ACCEPT_ENCODING },
+    [4] = { "connection", 10, FIELD_CONNECTION },
+    [5] = { "referer", 7, FIELD_REFERER },
+    [8] = { "content-length", 14, FIELD_CONTENT_LENGTH },
+    [11] = { "range", 5, FIELD_RANGE },
+    [12] = { "if-range", 8, FIELD_IF_RANGE },
+    [17] = { "if-none-match", 13, FIELD_IF_NONE_MATCH },
+    [21] = { "if-modified-since", 17, FIELD_IF_MODIFIED_SINCE },
+    [22] = { "expect", 6, FIELD_EXPECT },
+    [24] = { "accept", 6, FIELD_ACCEPT },
+    [28] = { "user-agent", 10, FIELD_USER_AGENT },
+    [29] = { "transfer-encoding", 17, FIELD_TRANSFER_ENCODING },
+    [30] = { "host", 4, FIELD_HOST },
+};
+
+static enum header_field get_field(const char *name, size_t size)
+{
+    // Case insensitive, one compare whatever the number of known names
+    if (size < 2)
+        return FIELD_OTHER;
+
+    size_t hash = (size + ((unsigned char)name[1] | 0x20) * 6)
+        & (FIELD_HASH_SIZE - 1);
+    if (known_fields[hash].size != size
+        || !string_n_casecmp(name, known_fields[hash].name, size))
+        return FIELD_OTHER;
 
-    return index + 1 < request->size && data[index] == ':';
+    return known_fields[hash].id;
 }
 
-static bool parse_host_field(struct string *request, size_t *index,
-                             struct request_header *req_header)
+static bool is_connection_token(const char *data, size_t size,
+                                const char *token)
 {
-    char *data = request->data;
-    size_t i = *index + 5; // Skip field name "Host:"
-    size_t host_length = 0;
+    size_t token_len = strlen(token);
+    return size == token_len && string_n_casecmp(data, token, token_len);
+}
 
-    // Skip spaces after colon
-    while (i < request->size && (data[i] == ' ' || data[i] == '\t'))
-        i++;
+static void parse_connection_value(struct http_parser *parser,
+                                   const char *data)
+{
+    size_t i = parser->value_start;
 
-    size_t start = i;
-    // Get length of host field value
-    while (i < request->size
-           && (is_valid_field_name_char(request->data[i]) || data[i] == ':')
-           && (data[i] != ' ' || data[i] != '\t'))
-        i++;
+    // Traverse comma separated list of connection options
+    while (i < parser->value_end)
+    {
+        // Skip spaces and separators
+        if (data[i] == ' ' || data[i] == '\t' || data[i] == ',')
+        {
+            i++;
+            continue;
+        }
 
-    host_length = i - start;
+        size_t start = i;
+        while (i < parser->value_end && is_token_char(data[i]))
+            i++;
 
-    // Skip spaces after colon
-    while (i < request->size && (data[i] == ' ' || data[i] == '\t'))
-        i++;
+        if (is_connection_token(data + start, i - start, "close"))
+            parser->connection = CONNECTION_CLOSE;
+        else if (is_connection_token(data + start, i - start, "keep-alive"))
+            parser->connection = CONNECTION_KEEP_ALIVE;
 
-    // Move to the end of the line
-    while (i + 1 < request->size && !(data[i] == '\r' && data[i + 1] == '\n'))
-        i++;
+        // Skip invalid character to avoid looping on it
+        if (i == start)
+            i++;
+    }
+}
 
-    // Unfinished header
-    if (i >= request->size)
-        return false;
+static void end_field(struct http_parser *parser, const char *data)
+{
+    if (!parser->in_value)
+        parser->value_start = parser->value_end;
+
+    struct field_offsets *field = &parser->fields[parser->field_count++];
+    field->value_start = parser->value_start;
+    field->value_end = parser->value_end;
+    if (field->id == FIELD_CONNECTION)
+        parse_connection_value(parser, data);
+}
 
-    req_header->host = string_create(data + start, host_length);
-    return true;
+static bool is_blank(char c)
+{
+    return c == ' ' || c == '\t';
 }
 
-static void parse_headers(struct string *request, size_t i,
-                          struct request_header *req_header)
+static enum parse_state step_field_value(struct http_parser *parser,
+                                         const char *data, size_t i)
 {
-    char *data = request->data;
+    char c = data[i];
 
-    // Traverse header fields
-    while (!end_of_header(request, i))
+    // Leading and trailing blanks are not part of the value
+    if (is_blank(c))
+        return STATE_FIELD_VALUE;
+    if (c == '\r')
     {
-        // Host field line
-        if (i + 5 < request->size && string_n_casecmp(data + i, "Host:", 5))
-        {
-            if (req_header->host || !parse_host_field(request, &i, req_header))
-            {
-                req_header->status = BAD_REQUEST;
-                return;
-            }
-        }
-        // Check validity of other field lines
-        else if (!is_valid_header_line(request, i))
-        {
-            req_header->status = BAD_REQUEST;
-            return;
-        }
-
-        // Move to next line
-        while (i + 2 < request->size
-               && !(data[i] == '\r' && data[i + 1] == '\n'))
-            i++;
-
-        i += 2; // Skip CRLF
+        end_field(parser, data);
+        return STATE_FIELD_LF;
     }
+    if (!is_visible_char(c))
+        return error(parser);
+
+    if (!parser->in_value)
+        parser->value_start = i;
+    parser->in_value = true;
+    parser->value_end = i + 1;
+    return STATE_FIELD_VALUE;
 }
 
-static void parse_filename(struct string *request, size_t *i,
-                           struct request_header *req_header,
-                           const struct config *config)
+static enum parse_state step_field(struct http_parser *parser,
+                                   const char *data, size_t i)
 {
-    size_t filename_len = get_filename_length(request->data, request->size, *i);
-    if (filename_len == 0)
-        req_header->status = BAD_REQUEST;
-
-    req_header->target = string_create(request->data + *i, filename_len);
-    req_header->filename = string_create(config->servers->root_dir,
-                                         strlen(config->servers->root_dir));
-    string_concat_str(req_header->filename, request->data + *i, filename_len);
+    char c = data[i];
+    struct field_offsets *field = &parser->fields[parser->field_count];
 
-    // If given target is a directory, append default file
-    if (req_header->filename->data[req_header->filename->size - 1] == '/')
+    switch (parser->state)
     {
-        string_concat_str(req_header->filename, config->servers->default_file,
-                          strlen(config->servers->default_file));
+    case STATE_FIELD_START:
+        // Empty line ends the header, obsolete line folding is rejected
+        if (c == '\r')
+            return STATE_HEADER_END_LF;
+        if (!is_token_char(c) || parser->field_count == HEADER_FIELDS_MAX)
+            return error(parser);
+        field->name_start = i;
+        return STATE_FIELD_NAME;
+    case STATE_FIELD_NAME:
+        if (is_token_char(c))
+            return STATE_FIELD_NAME;
+        if (c != ':')
+            return error(parser);
+        field->name_end = i;
+        field->id = get_field(data + field->name_start, i - field->name_start);
+        parser->in_value = false;
+        parser->value_end = i + 1;
+        return STATE_FIELD_VALUE;
+    case STATE_FIELD_VALUE:
+        return step_field_value(parser, data, i);
+    case STATE_FIELD_LF:
+        return c == '\n' ? STATE_FIELD_START : error(parser);
+    default:
+        return c == '\n' ? STATE_COMPLETE : error(parser);
     }
+}
 
-    // Add null byte
-    string_concat_str(req_header->filename, "", 1);
-    *i += filename_len;
+static void skip_value(struct http_parser *parser, const char *data,
+                       size_t run)
+{
+    // Leading and trailing blanks are not part of the value
+    size_t start = 0;
+    size_t end = run;
+    while (!parser->in_value && start < end && is_blank(data[start]))
+        start++;
+    while (end > start && is_blank(data[end - 1]))
+        end--;
+    if (start == end)
+        return;
+
+    if (!parser->in_value)
+        parser->value_start = parser->position + start;
+    parser->in_value = true;
+    parser->value_end = parser->position + end;
 }
 
-static void parse_version(struct string *request, size_t *i,
-                          struct request_header *req_header)
+static void skip_run(struct http_parser *parser, const struct string *request)
 {
-    // Traverse HTTP version
+    // Bulk skip the bytes that would not change the state, the next one is
+    // left to the state machine
+    const char *data = request->data + parser->position;
+    size_t size = request->size - parser->position;
+    size_t run = 0;
 
-    req_header->version = string_create(request->data + *i, 8); // "HTTP/x.x"
-    if (memcmp(req_header->version->data, HTTP_VERSION, 8))
-        req_header->status = UNSUPPORTED_VERSION;
+    switch (parser->state)
+    {
+    case STATE_METHOD:
+    case STATE_FIELD_NAME:
+        run = scan_token(data, size);
+        break;
+    case STATE_TARGET:
+        run = scan_visible(data, size);
+        break;
+    case STATE_FIELD_VALUE:
+        run = scan_field_value(data, size);
+        skip_value(parser, data, run);
+        break;
+    default:
+        break;
+    }
 
-    *i += req_header->version->size;
+    parser->position += run;
 }
 
-static size_t parse_start(struct string *request,
-                          struct request_header *req_header,
-                          const struct config *config)
+void http_parser_init(struct http_parser *parser)
 {
-    size_t i = 0;
-    req_header->method = get_method(request->data, request->size);
-    if (req_header->method == UNKNOWN)
-        req_header->status = METHOD_NOT_ALLOWED;
+    // Clearing the whole field table per request would be wasted
+    memset(parser, 0, offsetof(struct http_parser, fields));
+}
 
-    // Move to the end of method string
-    while (i < request->size && request->data[i] != ' ')
-        i++;
+enum parse_result http_parser_feed(struct http_parser *parser,
+                                   const struct string *request)
+{
+    // Only look at bytes received since the previous call
+    while (parser->state != STATE_COMPLETE && parser->state != STATE_ERROR
+           && parser->position < request->size)
+    {
+        skip_run(parser, request);
+        if (parser->position == request->size)
+            break;
+
+        size_t i = parser->position++;
+        parser->state = parser->state < STATE_FIELD_START
+            ? step_request_line(parser, i, request->data[i])
+            : step_field(parser, request->data, i);
+    }
 
-    // Request line malformed
-    if (i + 2 >= request->size || request->data[i++] != ' '
-        || (request->data[i] == '\r' && request->data[i + 1] == '\n'))
-        req_header->status = BAD_REQUEST;
+    // Reject oversized headers, incomplete ones without waiting for their end
+    if (parser->position > REQUEST_HEADER_MAX
+        || (parser->position == REQUEST_HEADER_MAX
+            && parser->state != STATE_COMPLETE))
+        parser->state = STATE_ERROR;
 
-    parse_filename(request, &i, req_header, config);
+    if (parser->state == STATE_COMPLETE)
+        return PARSE_COMPLETE;
+    if (parser->state == STATE_ERROR)
+        return PARSE_ERROR;
 
-    // Request line malformed
-    if (i + 2 >= request->size || request->data[i++] != ' '
-        || (request->data[i] == '\r' && request->data[i + 1] == '\n'))
-        req_header->status = BAD_REQUEST;
+    return PARSE_NEED_MORE;
+}
 
-    parse_version(request, &i, req_header);
+static void build_filename(struct request_header *req_header,
+                           const struct config *config)
+{
+    const char *root = config->servers->root_dir;
+    const char *default_file = config->servers->default_file;
+    const struct string *target = &req_header->target;
+    size_t root_len = strlen(root);
+    size_t size = root_len + target->size;
 
-    // Wrongly terminated request line
-    if (i + 2 >= request->size || request->data[i] != '\r'
-        || request->data[i + 1] != '\n')
-        req_header->status = BAD_REQUEST;
+    // If given target is a directory, append default file
+    bool directory = size > 0
+        && (target->size ? target->data[target->size - 1]
+                         : root[root_len - 1])
+            == '/';
+    size_t default_len = directory ? strlen(default_file) : 0;
 
-    i += 2;
+    if (size + default_len >= PATH_MAX)
+    {
+        if (req_header->status == OK)
+            req_header->status = URI_TOO_LONG;
+        req_header->filename[0] = '\0';
+        return;
+    }
 
-    return i;
+    char *filename = req_header->filename;
+    memcpy(filename, root, root_len);
+    memcpy(filename + root_len, target->data, target->size);
+    memcpy(filename + size, default_file, default_len);
+    filename[size + default_len] = '\0';
 }
 
-static bool is_valid_host(const struct config *config, struct string *host)
+static bool is_valid_host(const struct config *config,
+                          const struct string *host)
 {
     // Basic validation: check if host is not empty
-    if (host->size == 0)
+    if (!host->data || host->size == 0)
         return false;
 
     // If host matches server_name
@@ -271,40 +382,175 @@ static bool is_valid_host(const struct config *config, struct string *host)
     return false;
 }
 
-struct request_header *parse_request(struct string *request,
-                                     const struct config *config)
+static void reset_request(struct request_header *req_header)
+{
+    // Only terminate filename, clearing PATH_MAX bytes per request is wasted
+    req_header->method = UNKNOWN;
+    req_header->status = OK;
+    req_header->target = (struct string){ 0 };
+    req_header->version = (struct string){ 0 };
+    req_header->host = (struct string){ 0 };
+    req_header->keep_alive = false;
+    req_header->has_body = false;
+    req_header->filename[0] = '\0';
+    req_header->field_count = 0;
+    memset(req_header->known, 0, sizeof(req_header->known));
+}
+
+static void finish_request_line(const struct http_parser *parser,
+                                struct string *request,
+                                const struct config *config,
+                                struct request_header *req_header)
 {
-    if (!request || request->size == 0)
-        return NULL;
+    const char *method = request->data + parser->method_start;
+    size_t method_len = parser->method_end - parser->method_start;
+    if (method_len == 3 && !memcmp(method, "GET", 3))
+        req_header->method = GET;
+    else if (method_len == 4 && !memcmp(method, "HEAD", 4))
+        req_header->method = HEAD;
+    else
+        req_header->status = METHOD_NOT_ALLOWED;
 
-    struct request_header *req_header =
-        calloc(1, sizeof(struct request_header));
+    req_header->target.data = request->data + parser->target_start;
+    req_header->target.size = parser->target_end - parser->target_start;
+    build_filename(req_header, config);
 
-    req_header->status = OK;
-    size_t i = parse_start(request, req_header, config);
-    if (req_header->status != OK)
-        return req_header;
+    // HTTP/1.1 connections are persistent by default, HTTP/1.0 ones are not
+    req_header->version.data = request->data + parser->version_start;
+    req_header->version.size = 8;
+    if (!memcmp(req_header->version.data, HTTP_VERSION, 8))
+        req_header->keep_alive = true;
+    else if (memcmp(req_header->version.data, HTTP_VERSION_1_0, 8))
+        req_header->status = UNSUPPORTED_VERSION;
 
-    parse_headers(request, i, req_header);
+    if (parser->connection != CONNECTION_DEFAULT)
+        req_header->keep_alive = parser->connection == CONNECTION_KEEP_ALIVE;
+}
 
-    if (req_header->status != OK)
-        return req_header;
+static struct string offsets_to_view(struct string *request, size_t start,
+                                     size_t end)
+{
+    struct string view = { .size = end - start, .data = request->data + start };
+    return view;
+}
 
-    // Check mandatory Host header
-    if (req_header->host == NULL || !is_valid_host(config, req_header->host))
-        req_header->status = BAD_REQUEST;
+/*
+** @brief Fill the field table of req_header from the offsets of the parser
+**
+** @return true if more than one Host field was received
+*/
+static bool finish_fields(const struct http_parser *parser,
+                          struct string *request,
+                          struct request_header *req_header)
+{
+    bool duplicate_host = false;
 
-    return req_header;
+    for (size_t i = 0; i < parser->field_count; i++)
+    {
+        const struct field_offsets *offsets = &parser->fields[i];
+        struct http_field *field = &req_header->fields[i];
+        field->id = offsets->id;
+        field->name =
+            offsets_to_view(request, offsets->name_start, offsets->name_end);
+        field->value =
+            offsets_to_view(request, offsets->value_start, offsets->value_end);
+
+        if (field->id == FIELD_OTHER)
+            continue;
+        if (req_header->known[field->id])
+            duplicate_host |= field->id == FIELD_HOST;
+        else
+            req_header->known[field->id] = i + 1;
+    }
+
+    req_header->field_count = parser->field_count;
+    return duplicate_host;
+}
+
+static bool is_digits(const struct string *value)
+{
+    for (size_t i = 0; i < value->size; i++)
+        if (value->data[i] < '0' || value->data[i] > '9')
+            return false;
+    return value->size > 0;
 }
 
-void destroy_request(struct request_header *request)
+/*
+** @brief Look at the fields framing a body, any length other than 0 or a
+**        Transfer-Encoding declares one
+**
+** @return false if the framing is invalid or ambiguous, like Content-Length
+**         along with Transfer-Encoding or lengths that differ
+*/
+static bool check_body(struct request_header *req_header)
 {
-    if (!request)
+    const struct string *length =
+        get_request_field(req_header, FIELD_CONTENT_LENGTH);
+    bool chunked = get_request_field(req_header, FIELD_TRANSFER_ENCODING);
+    if (!length)
+    {
+        req_header->has_body = chunked;
+        return true;
+    }
+
+    for (size_t i = 0; i < req_header->field_count; i++)
+    {
+        const struct string *value = &req_header->fields[i].value;
+        if (req_header->fields[i].id == FIELD_CONTENT_LENGTH
+            && (!is_digits(value) || value->size != length->size
+                || memcmp(value->data, length->data, value->size)))
+            return false;
+    }
+
+    for (size_t i = 0; i < length->size; i++)
+        req_header->has_body |= length->data[i] != '0';
+    return !chunked;
+}
+
+void http_parser_finish(const struct http_parser *parser,
+                        struct string *request, const struct config *config,
+                        struct request_header *req_header)
+{
+    reset_request(req_header);
+    if (parser->state != STATE_COMPLETE)
+    {
+        req_header->status = BAD_REQUEST;
         return;
+    }
+
+    // Fields are needed by rejected requests too, a body they declare ends
+    // the connection
+    finish_request_line(parser, request, config, req_header);
+    bool duplicate_host = finish_fields(parser, request, req_header);
+    if (!check_body(req_header))
+        req_header->status = BAD_REQUEST;
+    if (req_header->status != OK)
+        return;
+
+    // Check unique Host header, only HTTP/1.1 requires one
+    const struct string *host = get_request_field(req_header, FIELD_HOST);
+    bool required = !memcmp(req_header->version.data, HTTP_VERSION, 8);
+    if (host)
+        req_header->host = *host;
+    if (duplicate_host
+        || ((host || required) && !is_valid_host(config, &req_header->host)))
+        req_header->status = BAD_REQUEST;
+}
+
+void parse_request(struct string *request, const struct config *config,
+                   struct request_header *req_header)
+{
+    struct http_parser parser;
+    http_parser_init(&parser);
 
-    string_destroy(request->filename);
-    string_destroy(request->version);
-    string_destroy(request->target);
-    string_destroy(request->host);
-    free(request);
+    if (request)
+        http_parser_feed(&parser, request);
+    http_parser_finish(&parser, request, config, req_header);
+}
+
+const struct string *get_request_field(const struct request_header *req_header,
+                                       enum header_field field)
+{
+    unsigned char index = req_header->known[field];
+    return index ? &req_header->fields[index - 1].value : NULL;
 }
@@ -1,105 +1,315 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stddef.h>
-#include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
 #include "http.h"
 
-static struct string *get_status_string(enum request_status status)
+// Longest delimiter and fields before a part of a multipart body
+#define PART_HEADER_MAX 128
+// Separates the parts of multipart/byteranges bodies
+#define MULTIPART_BOUNDARY "3d6b6a416f9b5e7c2a81"
+#define MULTIPART_LINE                                                         \
+    "Content-Type: multipart/byteranges; boundary=" MULTIPART_BOUNDARY "\r\n"
+// Longest ETag, Last-Modified or Content-Encoding value written
+#define VALIDATOR_MAX 64
+// Digits of the largest off_t
+#define NUMBER_MAX 19
+
+// Longest line of the field name with a value of at most value_max bytes
+#define FIELD_LINE_MAX(name, value_max) (sizeof(name) - 1 + (value_max) + 2)
+// Longest Content-Range line, "bytes first-last/size"
+#define CONTENT_RANGE_LINE_MAX                                                 \
+    FIELD_LINE_MAX("Content-Range: ", sizeof("bytes -/") - 1 + 3 * NUMBER_MAX)
+// End of the status line and the longest Date, Content-Length, ETag,
+// Last-Modified, Content-Encoding and Content-Range lines, written for each
+// response
+#define RESPONSE_FIELDS_MAX                                                    \
+    (2 + FIELD_LINE_MAX("Date: ", HTTP_DATE_SIZE)                              \
+     + FIELD_LINE_MAX("Content-Length: ", NUMBER_MAX)                          \
+     + FIELD_LINE_MAX("ETag: ", VALIDATOR_MAX)                                 \
+     + FIELD_LINE_MAX("Last-Modified: ", VALIDATOR_MAX)                        \
+     + FIELD_LINE_MAX("Content-Encoding: ", VALIDATOR_MAX)                     \
+     + CONTENT_RANGE_LINE_MAX)
+
+// The multipart Content-Type line is written in place of the Content-Range
+// one, fail to compile if it does not fit
+typedef char multipart_line_fits
+    [sizeof(MULTIPART_LINE) - 1 <= CONTENT_RANGE_LINE_MAX ? 1 : -1];
+
+// Status lines are shared by every response instead of allocated per response
+#define STATUS_LINE(text)                                                      \
+    {                                                                          \
+        sizeof(HTTP_VERSION " " text) - 1, HTTP_VERSION " " text, 0            \
+    }
+
+static const struct string *get_status_string(enum request_status status)
 {
-    size_t version_size = strlen(HTTP_VERSION);
+    static const struct string ok = STATUS_LINE("200 OK");
+    static const struct string partial = STATUS_LINE("206 Partial Content");
+    static const struct string not_modified =
+        STATUS_LINE("304 Not Modified");
+    static const struct string bad_request = STATUS_LINE("400 Bad Request");
+    static const struct string forbidden = STATUS_LINE("403 Forbidden");
+    static const struct string not_found = STATUS_LINE("404 Not Found");
+    static const struct string not_allowed =
+        STATUS_LINE("405 Method Not Allowed");
+    static const struct string too_long = STATUS_LINE("414 URI Too Long");
+    static const struct string not_satisfiable =
+        STATUS_LINE("416 Range Not Satisfiable");
+    static const struct string unsupported =
+        STATUS_LINE("505 HTTP Version Not Supported");
+    static const struct string internal_error =
+        STATUS_LINE("500 Internal Server Error");
 
     switch (status)
     {
     case OK:
-        return string_create(HTTP_VERSION " 200 OK",
-                             strlen(" 200 OK") + version_size);
+        return &ok;
+    case PARTIAL_CONTENT:
+        return &partial;
+    case NOT_MODIFIED:
+        return &not_modified;
     case BAD_REQUEST:
-        return string_create(HTTP_VERSION " 400 Bad Request",
-                             strlen(" 400 Bad Request") + version_size);
+        return &bad_request;
     case FORBIDDEN:
-        return string_create(HTTP_VERSION " 403 Forbidden",
-                             strlen(" 403 Forbidden") + version_size);
+        return &forbidden;
     case NOT_FOUND:
-        return string_create(HTTP_VERSION " 404 Not Found",
-                             strlen(" 404 Not Found") + version_size);
+        return &not_found;
     case METHOD_NOT_ALLOWED:
-        return string_create(HTTP_VERSION " 405 Method Not Allowed",
-                             strlen(" 405 Method Not Allowed") + version_size);
+        return &not_allowed;
+    case URI_TOO_LONG:
+        return &too_long;
+    case RANGE_NOT_SATISFIABLE:
+        return &not_satisfiable;
     case UNSUPPORTED_VERSION:
-        return string_create(HTTP_VERSION " 505 HTTP Version Not Supported",
-                             strlen(" 505 HTTP Version Not Supported")
-                                 + version_size);
+        return &unsupported;
     default:
-        return string_create(HTTP_VERSION " 500 Internal Server Error",
-                             strlen(" 500 Internal Server Error")
-                                 + version_size);
+        return &internal_error;
     }
 }
 
-struct response_header *create_response(const struct request_header *request,
-                                        off_t content_length)
+void http_date_update(struct http_date *date, time_t now)
 {
-    struct response_header *response = malloc(sizeof(struct response_header));
-    response->status = get_status_string(request->status);
+    date->value.data = date->buffer;
+    if (date->value.size && date->time == now)
+        return;
 
-    time_t now = time(NULL);
-    struct tm *tm_info = gmtime(&now);
+    struct tm tm_info;
+    gmtime_r(&now, &tm_info);
     // Format time as Day (3 letters), DD Mon YYYY HH:MM:SS GMT
-    char time_str[30];
-    strftime(time_str, sizeof(time_str), "%a, %d %b %Y %H:%M:%S GMT", tm_info);
-    response->date = string_create(time_str, strlen(time_str));
+    date->value.size = strftime(date->buffer, sizeof(date->buffer),
+                                "%a, %d %b %Y %H:%M:%S GMT", &tm_info);
+    date->time = now;
+}
+
+struct response_header *create_response(const struct request_header *request,
+                                        off_t content_length,
+                                        const struct http_date *date,
+                                        struct arena *arena)
+{
+    struct response_header *response =
+        arena_alloc(arena, sizeof(struct response_header));
+    if (!response)
+        return NULL;
 
+    response->status = get_status_string(request->status);
+    response->date = &date->value;
     response->content_length = content_length;
     response->status_code = request->status;
+    response->keep_alive = request->keep_alive;
+    response->etag = NULL;
+    response->last_modified = NULL;
+    response->accept_ranges = false;
+    response->ranges = NULL;
+    response->range_count = 0;
+    response->file_size = 0;
+    response->content_encoding = NULL;
+    response->vary_encoding = false;
     return response;
 }
 
-struct string *response_header_to_string(const struct response_header *response)
+static void add_part(struct header_parts *header, const char *data,
+                     size_t size)
 {
-    struct string *header = string_create("", 0);
+    header->parts[header->count].iov_base = (char *)data;
+    header->parts[header->count++].iov_len = size;
+    header->size += size;
+}
 
-    char *field_end = "\r\n";
-    size_t field_end_len = strlen(field_end);
+static char *append(char *buffer, const char *data, size_t size)
+{
+    memcpy(buffer, data, size);
+    return buffer + size;
+}
 
-    // Status line
-    string_concat_str(header, response->status->data, response->status->size);
-    string_concat_str(header, field_end, field_end_len);
-    //  Date line
-    string_concat_str(header, "Date: ", strlen("Date: "));
-    string_concat_str(header, response->date->data, response->date->size);
-    string_concat_str(header, field_end, field_end_len);
+static char *append_number(char *buffer, off_t number)
+{
+    char digits[24];
+    size_t count = 0;
 
-    if (response->status_code == METHOD_NOT_ALLOWED)
+    do
     {
-        // Allow line for 405 Method Not Allowed
-        string_concat_str(header, "Allow: GET, HEAD\r\n",
-                          strlen("Allow: GET, HEAD\r\n"));
+        digits[count++] = '0' + number % 10;
+        number /= 10;
+    } while (number > 0);
+
+    while (count)
+        *buffer++ = digits[--count];
+    return buffer;
+}
+
+static char *append_field(char *buffer, const char *name, const char *value)
+{
+    buffer = append(buffer, name, strlen(name));
+    buffer = append(buffer, value, strnlen(value, VALIDATOR_MAX));
+    return append(buffer, "\r\n", strlen("\r\n"));
+}
+
+// "bytes first-last/size", or "bytes */size" without range
+static char *append_range(char *buffer, const struct byte_range *range,
+                          off_t size)
+{
+    buffer = append(buffer, "bytes ", strlen("bytes "));
+    if (range)
+    {
+        buffer = append_number(buffer, range->start);
+        *buffer++ = '-';
+        buffer = append_number(buffer, range->start + range->length - 1);
     }
+    else
+        *buffer++ = '*';
+    *buffer++ = '/';
+    return append_number(buffer, size);
+}
 
-    // Content-Length line
-    char content_length_str[50];
-    sprintf(content_length_str, "Content-Length: %ld\r\n",
-            response->content_length);
-    string_concat_str(header, content_length_str, strlen(content_length_str));
+static char *write_range_fields(const struct response_header *response,
+                                char *end)
+{
+    static const char content_range[] = "Content-Range: ";
+    static const char multipart[] = MULTIPART_LINE;
 
-    // Connection line
-    string_concat_str(header, "Connection: close\r\n",
-                      strlen("Connection: close\r\n"));
+    if (response->status_code == PARTIAL_CONTENT && response->range_count > 1)
+        return append(end, multipart, sizeof(multipart) - 1);
 
-    // End header
-    string_concat_str(header, field_end, field_end_len);
+    const struct byte_range *range = NULL;
+    if (response->status_code == PARTIAL_CONTENT)
+        range = response->ranges;
+    else if (response->status_code != RANGE_NOT_SATISFIABLE)
+        return end;
+
+    end = append(end, content_range, sizeof(content_range) - 1);
+    end = append_range(end, range, response->file_size);
+    return append(end, "\r\n", strlen("\r\n"));
+}
+
+static const char *write_fields(const struct response_header *response,
+                                char *buffer)
+{
+    // Ends the status line, whose static string has no line ending
+    char *end = append(buffer, "\r\nDate: ", strlen("\r\nDate: "));
+    end = append(end, response->date->data, response->date->size);
+    end = append(end, "\r\n", strlen("\r\n"));
+
+    // A 304 has no body, the cached response keeps its own length
+    if (response->status_code != NOT_MODIFIED)
+    {
+        end = append(end, "Content-Length: ", strlen("Content-Length: "));
+        end = append_number(end, response->content_length);
+        end = append(end, "\r\n", strlen("\r\n"));
+    }
+
+    if (response->etag)
+        end = append_field(end, "ETag: ", response->etag);
+    if (response->last_modified)
+        end = append_field(end, "Last-Modified: ", response->last_modified);
+    if (response->content_encoding)
+        end = append_field(end, "Content-Encoding: ",
+                           response->content_encoding);
+    return write_range_fields(response, end);
+}
+
+struct header_parts *
+response_header_to_parts(const struct response_header *response,
+                         struct arena *arena)
+{
+    struct header_parts *header = arena_alloc(arena, sizeof(*header));
+    char *fields = arena_alloc(arena, RESPONSE_FIELDS_MAX);
+    if (!header || !fields)
+        return NULL;
+
+    header->count = 0;
+    header->size = 0;
+
+    // Status line and fields common to many responses are never copied
+    add_part(header, response->status->data, response->status->size);
+    add_part(header, fields, write_fields(response, fields) - fields);
+
+    // Allow line for 405 Method Not Allowed
+    static const char allow[] = "Allow: GET, HEAD\r\n";
+    if (response->status_code == METHOD_NOT_ALLOWED)
+        add_part(header, allow, sizeof(allow) - 1);
+
+    static const char accept_ranges[] = "Accept-Ranges: bytes\r\n";
+    if (response->accept_ranges)
+        add_part(header, accept_ranges, sizeof(accept_ranges) - 1);
+
+    static const char vary[] = "Vary: Accept-Encoding\r\n";
+    if (response->vary_encoding)
+        add_part(header, vary, sizeof(vary) - 1);
+
+    // Connection line and end of header
+    static const char keep_alive[] = "Connection: keep-alive\r\n\r\n";
+    static const char closing[] = "Connection: close\r\n\r\n";
+    if (response->keep_alive)
+        add_part(header, keep_alive, sizeof(keep_alive) - 1);
+    else
+        add_part(header, closing, sizeof(closing) - 1);
 
     return header;
 }
 
-void destroy_response(struct response_header *response)
+static size_t write_part_header(const struct response_header *response,
+                                size_t index, char *buffer)
 {
-    if (!response)
-        return;
+    static const char delimiter[] = "--" MULTIPART_BOUNDARY;
+    static const char content_range[] = "\r\nContent-Range: ";
 
-    string_destroy(response->status);
-    string_destroy(response->date);
-    free(response);
+    // Every delimiter but the first ends the previous part
+    char *end = index ? append(buffer, "\r\n", strlen("\r\n")) : buffer;
+    end = append(end, delimiter, sizeof(delimiter) - 1);
+    if (index == response->range_count)
+        return append(end, "--\r\n", strlen("--\r\n")) - buffer;
+
+    end = append(end, content_range, sizeof(content_range) - 1);
+    end = append_range(end, &response->ranges[index], response->file_size);
+    return append(end, "\r\n\r\n", strlen("\r\n\r\n")) - buffer;
+}
+
+off_t multipart_length(const struct response_header *response)
+{
+    char buffer[PART_HEADER_MAX];
+    off_t length = 0;
+    for (size_t i = 0; i <= response->range_count; i++)
+    {
+        length += write_part_header(response, i, buffer);
+        if (i < response->range_count)
+            length += response->ranges[i].length;
+    }
+    return length;
+}
+
+struct header_parts *multipart_header(const struct response_header *response,
+                                      size_t index, struct arena *arena)
+{
+    struct header_parts *header = arena_alloc(arena, sizeof(*header));
+    char *buffer = arena_alloc(arena, PART_HEADER_MAX);
+    if (!header || !buffer)
+        return NULL;
+
+    header->count = 0;
+    header->size = 0;
+    add_part(header, buffer, write_part_header(response, index, buffer));
+    return header;
 }
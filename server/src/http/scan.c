@@ -0,0 +1,168 @@
+#include "scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#    include <nmmintrin.h>
+#    define SCAN_SSE42
+#endif
+
+// tchar from RFC 9110: ALPHA, DIGIT and !#$%&'*+-.^_`|~
+static const char token_chars[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x00
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x10
+    0, 1, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0, // 0x20  !"#$%&'()*+,-./
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, // 0x30 0123456789:;<=>?
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x40 @ABCDEFGHIJKLMNO
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 1, // 0x50 PQRSTUVWXYZ[\]^_
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x60 `abcdefghijklmno
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 0, 1, 0, // 0x70 pqrstuvwxyz{|}~
+};
+
+bool is_token_char(char c)
+{
+    return token_chars[(unsigned char)c];
+}
+
+bool is_visible_char(char c)
+{
+    // VCHAR and obs-text
+    unsigned char u = c;
+    return (u > 0x20 && u < 0x7f) || u >= 0x80;
+}
+
+static size_t scan_token_scalar(const char *data, size_t size)
+{
+    size_t i = 0;
+    while (i < size && is_token_char(data[i]))
+        i++;
+    return i;
+}
+
+static size_t scan_visible_scalar(const char *data, size_t size)
+{
+    size_t i = 0;
+    while (i < size && is_visible_char(data[i]))
+        i++;
+    return i;
+}
+
+static size_t scan_field_value_scalar(const char *data, size_t size)
+{
+    size_t i = 0;
+    while (i < size
+           && (is_visible_char(data[i]) || data[i] == ' ' || data[i] == '\t'))
+        i++;
+    return i;
+}
+
+#ifdef SCAN_SSE42
+
+/*
+** @brief Skip 16 bytes at a time until one falls in the given ranges, then
+**        let the scalar loop finish the last block. Like picohttpparser, loads
+**        never go past the end of data
+**
+** @param ranges Pairs of inclusive bounds of the bytes to stop at
+** @param ranges_size Number of bytes in ranges, at most 16
+*/
+__attribute__((target("sse4.2"))) static size_t
+find_range(const char *data, size_t size, const char *ranges,
+           int ranges_size)
+{
+    __m128i stops = _mm_loadu_si128((const __m128i *)ranges);
+    size_t i = 0;
+
+    while (size - i >= 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)(data + i));
+        int index = _mm_cmpestri(stops, ranges_size, block, 16,
+                                 _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES
+                                     | _SIDD_LEAST_SIGNIFICANT);
+        i += index;
+        if (index != 16)
+            break;
+    }
+
+    return i;
+}
+
+__attribute__((target("sse4.2"))) static size_t
+scan_token_sse42(const char *data, size_t size)
+{
+    // Superset of the non tchar bytes fitting in 8 ranges, '|' and '~' are
+    // checked by the scalar loop
+    static const char ranges[16] = "\x00 \"\"(),,//:@[]{\xff";
+    size_t i = 0;
+
+    for (;;)
+    {
+        i += find_range(data + i, size - i, ranges, sizeof(ranges));
+        if (size - i < 16 || !is_token_char(data[i]))
+            return i + scan_token_scalar(data + i, size - i);
+        i++;
+    }
+}
+
+__attribute__((target("sse4.2"))) static size_t
+scan_visible_sse42(const char *data, size_t size)
+{
+    static const char ranges[16] = "\x00 \x7f\x7f";
+    size_t i = find_range(data, size, ranges, 4);
+    return i + scan_visible_scalar(data + i, size - i);
+}
+
+__attribute__((target("sse4.2"))) static size_t
+scan_field_value_sse42(const char *data, size_t size)
+{
+    // Controls but HTAB, and DEL
+    static const char ranges[16] = "\x00\x08\x0a\x1f\x7f\x7f";
+    size_t i = find_range(data, size, ranges, 6);
+    return i + scan_field_value_scalar(data + i, size - i);
+}
+
+#endif /* SCAN_SSE42 */
+
+static size_t (*token_scanner)(const char *, size_t) = scan_token_scalar;
+static size_t (*visible_scanner)(const char *, size_t) = scan_visible_scalar;
+static size_t (*field_value_scanner)(const char *,
+                                     size_t) = scan_field_value_scalar;
+
+bool scan_use_simd(bool simd)
+{
+    token_scanner = scan_token_scalar;
+    visible_scanner = scan_visible_scalar;
+    field_value_scanner = scan_field_value_scalar;
+
+#ifdef SCAN_SSE42
+    __builtin_cpu_init();
+    if (simd && __builtin_cpu_supports("sse4.2"))
+    {
+        token_scanner = scan_token_sse42;
+        visible_scanner = scan_visible_sse42;
+        field_value_scanner = scan_field_value_sse42;
+        return true;
+    }
+#endif
+
+    return !simd;
+}
+
+// Pick the scanners before any worker thread starts
+__attribute__((constructor)) static void select_scanners(void)
+{
+    scan_use_simd(true);
+}
+
+size_t scan_token(const char *data, size_t size)
+{
+    return token_scanner(data, size);
+}
+
+size_t scan_visible(const char *data, size_t size)
+{
+    return visible_scanner(data, size);
+}
+
+size_t scan_field_value(const char *data, size_t size)
+{
+    return field_value_scanner(data, size);
+}
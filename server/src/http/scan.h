@@ -0,0 +1,45 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+** @brief Check if c is a tchar, a character allowed in methods and field
+**        names
+*/
+bool is_token_char(char c);
+
+/*
+** @brief Check if c is a visible character or obs-text
+*/
+bool is_visible_char(char c);
+
+/*
+** @brief Get the number of leading bytes of data that are tchars
+*/
+size_t scan_token(const char *data, size_t size);
+
+/*
+** @brief Get the number of leading bytes of data that are visible characters
+**        or obs-text, the characters allowed in targets and field values
+**        besides blanks
+*/
+size_t scan_visible(const char *data, size_t size);
+
+/*
+** @brief Get the number of leading bytes of data allowed in a field value,
+**        visible characters, obs-text, spaces and tabs
+*/
+size_t scan_field_value(const char *data, size_t size);
+
+/*
+** @brief Choose between the SSE4.2 and the scalar scanners. The SSE4.2 ones
+**        are picked at startup when the CPU supports them, this is only
+**        meant for benchmarks
+**
+** @return false if simd was requested but the CPU does not support it
+*/
+bool scan_use_simd(bool simd);
+
+#endif /* ! SCAN_H */
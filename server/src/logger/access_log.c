@@ -0,0 +1,71 @@
+#include "access_log.h"
+
+#include <string.h>
+
+static unsigned char *put_le(unsigned char *out, uint64_t value, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        out[i] = value >> (8 * i);
+    return out + size;
+}
+
+static uint64_t get_le(const unsigned char *in, size_t size)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; i++)
+        value |= (uint64_t)in[i] << (8 * i);
+    return value;
+}
+
+size_t access_log_header(unsigned char *buffer)
+{
+    memcpy(buffer, ACCESS_LOG_MAGIC, 4);
+    put_le(buffer + 4, ACCESS_LOG_VERSION, 2);
+    put_le(buffer + 6, ACCESS_RECORD_FIXED_SIZE, 2);
+    return ACCESS_LOG_HEADER_SIZE;
+}
+
+bool access_log_check_header(const unsigned char *data, size_t size)
+{
+    return size >= ACCESS_LOG_HEADER_SIZE
+        && !memcmp(data, ACCESS_LOG_MAGIC, 4)
+        && get_le(data + 4, 2) == ACCESS_LOG_VERSION
+        && get_le(data + 6, 2) == ACCESS_RECORD_FIXED_SIZE;
+}
+
+size_t access_log_encode(const struct access_entry *entry,
+                         unsigned char *buffer)
+{
+    unsigned char *out = put_le(buffer, entry->time, 8);
+    out = put_le(out, entry->client_ip, 4);
+    out = put_le(out, entry->latency, 4);
+    out = put_le(out, entry->bytes, 8);
+    out = put_le(out, entry->status, 2);
+    out = put_le(out, entry->method, 1);
+    out = put_le(out, 0, 1);
+    out = put_le(out, entry->target_length, 2);
+
+    if (entry->target_length)
+        memcpy(out, entry->target, entry->target_length);
+    return ACCESS_RECORD_FIXED_SIZE + entry->target_length;
+}
+
+size_t access_log_decode(const unsigned char *data, size_t size,
+                         struct access_entry *entry)
+{
+    if (size < ACCESS_RECORD_FIXED_SIZE)
+        return 0;
+
+    entry->target_length = get_le(data + 28, 2);
+    if (size < ACCESS_RECORD_FIXED_SIZE + (size_t)entry->target_length)
+        return 0;
+
+    entry->time = get_le(data, 8);
+    entry->client_ip = get_le(data + 8, 4);
+    entry->latency = get_le(data + 12, 4);
+    entry->bytes = get_le(data + 16, 8);
+    entry->status = get_le(data + 24, 2);
+    entry->method = get_le(data + 26, 1);
+    entry->target = (const char *)data + ACCESS_RECORD_FIXED_SIZE;
+    return ACCESS_RECORD_FIXED_SIZE + entry->target_length;
+}
@@ -0,0 +1,78 @@
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+** Binary access log: a file header followed by one record per request, all
+** integers little endian.
+**
+** Header: "HTAL", u16 version, u16 size of the fixed part of a record
+** Record: u64 time (seconds since the epoch), u32 client IPv4 address,
+**         u32 latency (microseconds), u64 bytes sent, u16 status,
+**         u8 method (enum http_method), u8 reserved, u16 target length,
+**         then the target bytes
+*/
+#define ACCESS_LOG_MAGIC "HTAL"
+#define ACCESS_LOG_VERSION 1
+#define ACCESS_LOG_HEADER_SIZE 8
+#define ACCESS_RECORD_FIXED_SIZE 30
+
+/*
+** @brief Request as stored in the binary access log
+**
+** @param time Time the request was answered, in seconds since the epoch
+** @param client_ip IPv4 address of the client, in host byte order
+** @param latency Microseconds between the first byte of the request and
+**        its response being queued
+** @param bytes Number of bytes of the response, header and body
+** @param status Status code of the response
+** @param method Method of the request, an enum http_method
+** @param target_length Number of bytes of target
+** @param target Target of the request, not NUL terminated
+*/
+struct access_entry
+{
+    uint64_t time;
+    uint32_t client_ip;
+    uint32_t latency;
+    uint64_t bytes;
+    uint16_t status;
+    uint8_t method;
+    uint16_t target_length;
+    const char *target;
+};
+
+/*
+** @brief Write the file header in buffer
+**
+** @return ACCESS_LOG_HEADER_SIZE
+*/
+size_t access_log_header(unsigned char *buffer);
+
+/*
+** @brief Check that data starts with the header of a log this version
+**        can read
+*/
+bool access_log_check_header(const unsigned char *data, size_t size);
+
+/*
+** @brief Serialize entry in buffer, which must hold
+**        ACCESS_RECORD_FIXED_SIZE + entry->target_length bytes
+**
+** @return the size of the record
+*/
+size_t access_log_encode(const struct access_entry *entry,
+                         unsigned char *buffer);
+
+/*
+** @brief Read the record at the start of data, entry->target points in data
+**
+** @return the size of the record, 0 if data holds only part of it
+*/
+size_t access_log_decode(const unsigned char *data, size_t size,
+                         struct access_entry *entry);
+
+#endif /* ! ACCESS_LOG_H */
@@ -2,6 +2,10 @@
 
 #include "logger.h"
 
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,46 +14,86 @@
 #include "../config/config.h"
 #include "../http/http.h"
 #include "../utils/string/string.h"
+#include "access_log.h"
 
-static FILE *log_file = NULL;
+#define TARGET_LOG_MAX 256
+#define LOG_TEXT_MAX 512
+// Longest the flusher sleeps before looking for new records
+#define LOG_FLUSH_INTERVAL_NS 100000000L
+// Time a worker waits for room when the ring is full and blocking
+#define LOG_BLOCK_WAIT_NS 1000000L
 
-int logger_init(const struct config *config)
+enum record_kind
 {
-    if (!config->log)
-        return 0;
-
-    if (!config->log_file)
-    {
-        log_file = stdout;
-        return 0;
-    }
-
-    log_file = fopen(config->log_file, "w");
-    if (!log_file)
-        return 1;
+    RECORD_MESSAGE,
+    RECORD_REQUEST,
+    RECORD_RESPONSE,
+    RECORD_ACCESS
+};
 
-    return 0;
-}
-
-void logger_log(const struct config *config, const char *message)
+/*
+** @brief Log line captured on the hot path, formatted when it is written
+**
+** @param sequence Position the slot is ready for, see claim_record
+** @param time Time the line was logged at
+** @param kind Whether text holds a whole message or the target of a request
+** @param status Status of the request
+** @param method Method of the request
+** @param client_ip Address of the client
+** @param stats Size and latency of the response, for access records
+** @param length Number of bytes of text
+*/
+struct log_record
 {
-    if (!log_file || !config->log)
-        return;
+    size_t sequence;
+    time_t time;
+    enum record_kind kind;
+    int status;
+    enum http_method method;
+    char client_ip[INET_ADDRSTRLEN];
+    struct access_stats stats;
+    size_t length;
+    char text[LOG_TEXT_MAX];
+};
 
-    // Get server name
-    char *server_name = strndup(config->servers->server_name->data,
-                                config->servers->server_name->size);
-    // Get current time in GMT
-    time_t now = time(NULL);
-    struct tm *tm_info = gmtime(&now);
-    // Format time as Day (3 letters), DD Mon YYYY HH:MM:SS GMT
-    char time_str[30];
-    strftime(time_str, sizeof(time_str), "%a, %d %b %Y %H:%M:%S GMT", tm_info);
-    fprintf(log_file, "%s [%s] %s\n", time_str, server_name, message);
+/*
+** @brief Bounded ring of records. Workers claim slots without locking and
+**        the flusher thread writes them out in batches. A slot belongs to a
+**        worker when its sequence equals the head it claimed, and to the
+**        flusher once the worker published it with sequence + 1
+**
+** @param records Slots, a power of two of them
+** @param mask Number of slots minus one
+** @param head Next position claimed by a worker
+** @param tail Next position written by the flusher
+** @param dropped Records lost because the ring was full
+** @param block Wait for room instead of dropping records
+** @param stopping Set by logger_destroy, the flusher drains and exits
+** @param config Configuration the records are formatted with
+** @param flusher Thread writing the records out
+** @param lock Protects the flusher's sleep
+** @param wakeup Wakes the flusher up early
+*/
+struct log_ring
+{
+    struct log_record *records;
+    size_t mask;
+    size_t head;
+    size_t tail;
+    size_t dropped;
+    bool block;
+    bool stopping;
+    const struct config *config;
+    pthread_t flusher;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+};
 
-    free(server_name);
-    fflush(log_file);
-}
+static FILE *log_file = NULL;
+static FILE *access_file = NULL;
+// Serializes lines written by the worker threads when logging synchronously
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct log_ring *ring = NULL;
 
 static const char *status_to_string(enum request_status status)
 {
@@ -63,6 +107,8 @@ static const char *status_to_string(enum request_status status)
         return "Not Found";
     case METHOD_NOT_ALLOWED:
         return "Method Not Allowed";
+    case URI_TOO_LONG:
+        return "URI Too Long";
     case UNSUPPORTED_VERSION:
         return "HTTP Version Not Supported";
     default:
@@ -70,61 +116,412 @@ static const char *status_to_string(enum request_status status)
     }
 }
 
-void logger_request(const struct config *config,
-                    const struct request_header *request,
-                    const struct string *client_ip)
+static void write_text(const struct log_record *record)
 {
-    if (!log_file || !config->log)
-        return;
+    int length = record->length;
 
-    char msg[512];
-    if (request->status == OK)
+    if (record->kind == RECORD_MESSAGE)
+        fprintf(log_file, "%.*s", length, record->text);
+    else if (record->kind == RECORD_REQUEST && record->status == OK)
+        fprintf(log_file, "received %s on '%.*s' from %s",
+                record->method == GET ? "GET" : "HEAD", length, record->text,
+                record->client_ip);
+    else if (record->kind == RECORD_REQUEST)
+        fprintf(log_file, "received %s from %s",
+                status_to_string(record->status), record->client_ip);
+    else if (record->status == BAD_REQUEST)
+        fprintf(log_file, "responding with %d to %s", record->status,
+                record->client_ip);
+    else
     {
-        char *target = request->target
-            ? strndup(request->target->data, request->target->size)
-            : strdup("/");
-        sprintf(msg, "received %s on '%s' from %s",
-                request->method == GET ? "GET" : "HEAD", target,
-                client_ip->data);
-        free(target);
+        const char *method = record->method == GET ? "GET"
+            : record->method == HEAD               ? "HEAD"
+                                                   : "UNKNOWN";
+        fprintf(log_file, "responding with %d to %s for %s on '%.*s'",
+                record->status, record->client_ip, method, length,
+                record->text);
     }
-    else
+}
+
+static FILE *write_access(const struct log_record *record)
+{
+    struct in_addr address = { 0 };
+    inet_pton(AF_INET, record->client_ip, &address);
+
+    struct access_entry entry = {
+        .time = record->time,
+        .client_ip = ntohl(address.s_addr),
+        .latency = record->stats.latency,
+        .bytes = record->stats.bytes,
+        .status = record->status,
+        .method = record->method,
+        .target_length = record->length,
+        .target = record->text,
+    };
+
+    unsigned char buffer[ACCESS_RECORD_FIXED_SIZE + LOG_TEXT_MAX];
+    fwrite(buffer, 1, access_log_encode(&entry, buffer), access_file);
+    return access_file;
+}
+
+static FILE *write_record(const struct config *config,
+                          const struct log_record *record)
+{
+    if (record->kind == RECORD_ACCESS)
+        return write_access(record);
+
+    // Format time as Day (3 letters), DD Mon YYYY HH:MM:SS GMT
+    struct tm tm_info;
+    gmtime_r(&record->time, &tm_info);
+    char time_str[30];
+    strftime(time_str, sizeof(time_str), "%a, %d %b %Y %H:%M:%S GMT", &tm_info);
+
+    const struct string *server_name = config->servers->server_name;
+    fprintf(log_file, "%s [%.*s] ", time_str, (int)server_name->size,
+            server_name->data);
+    write_text(record);
+    fputc('\n', log_file);
+    return log_file;
+}
+
+static bool wait_for_room(struct log_ring *ring)
+{
+    if (!ring->block)
     {
-        sprintf(msg, "received %s from %s", status_to_string(request->status),
-                client_ip->data);
+        __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+        return false;
     }
-    logger_log(config, msg);
+
+    struct timespec wait = { 0, LOG_BLOCK_WAIT_NS };
+    pthread_cond_signal(&ring->wakeup);
+    nanosleep(&wait, NULL);
+    return true;
 }
 
-void logger_response(const struct config *config,
-                     const struct request_header *request,
-                     const struct string *client_ip)
+static struct log_record *claim_record(struct log_ring *ring)
 {
-    if (!log_file || !config->log)
+    size_t position = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+    for (;;)
+    {
+        struct log_record *record = &ring->records[position & ring->mask];
+        size_t sequence =
+            __atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)position;
+
+        // Slot free, take it unless another worker was faster
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&ring->head, &position,
+                                            position + 1, true,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+                return record;
+            continue;
+        }
+
+        // Slot not written out yet since the last lap, the ring is full
+        if (diff < 0 && !wait_for_room(ring))
+            return NULL;
+        position = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    }
+}
+
+static void publish_record(struct log_ring *ring, struct log_record *record)
+{
+    size_t position = record->sequence;
+    __atomic_store_n(&record->sequence, position + 1, __ATOMIC_RELEASE);
+
+    // Wake the flusher up before the ring fills up rather than on every line
+    if ((position & (ring->mask >> 1)) == 0)
+        pthread_cond_signal(&ring->wakeup);
+}
+
+static struct log_record *begin_record(struct log_record *local)
+{
+    if (!ring)
+        return local;
+    return claim_record(ring);
+}
+
+static void end_record(const struct config *config,
+                       struct log_record *record)
+{
+    record->time = time(NULL);
+    if (ring)
+    {
+        publish_record(ring, record);
         return;
+    }
 
-    char msg[512];
+    pthread_mutex_lock(&log_lock);
+    fflush(write_record(config, record));
+    pthread_mutex_unlock(&log_lock);
+}
+
+static void write_dropped(struct log_ring *ring)
+{
+    size_t dropped = __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+    if (!dropped || !log_file)
+        return;
+
+    struct log_record record = { 0 };
+    record.time = time(NULL);
+    int length = snprintf(record.text, sizeof(record.text),
+                          "-- Log buffer full, %zu lines dropped", dropped);
+    record.length = length;
+    write_record(ring->config, &record);
+}
+
+static size_t drain_records(struct log_ring *ring)
+{
+    size_t count = 0;
 
-    if (request->status == BAD_REQUEST)
+    for (;;)
     {
-        sprintf(msg, "responding with %d to %s", request->status,
-                client_ip->data);
+        struct log_record *record = &ring->records[ring->tail & ring->mask];
+        if (__atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE)
+            != ring->tail + 1)
+            break;
+
+        write_record(ring->config, record);
+
+        // Hand the slot back for the next lap
+        __atomic_store_n(&record->sequence, ring->tail + ring->mask + 1,
+                         __ATOMIC_RELEASE);
+        ring->tail++;
+        count++;
     }
-    else
+
+    write_dropped(ring);
+    return count;
+}
+
+static void wait_for_records(struct log_ring *ring)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += LOG_FLUSH_INTERVAL_NS;
+    if (deadline.tv_nsec >= 1000000000L)
     {
-        char *target = request->target
-            ? strndup(request->target->data, request->target->size)
-            : strdup("/");
-        char *method = request->method == GET ? "GET"
-            : request->method == HEAD         ? "HEAD"
-                                              : "UNKNOWN";
-
-        sprintf(msg, "responding with %d to %s for %s on '%s'", request->status,
-                client_ip->data, method, target);
-        free(target);
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
     }
 
-    logger_log(config, msg);
+    pthread_mutex_lock(&ring->lock);
+    if (!ring->stopping)
+        pthread_cond_timedwait(&ring->wakeup, &ring->lock, &deadline);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+static void flush_files(void)
+{
+    if (log_file)
+        fflush(log_file);
+    if (access_file)
+        fflush(access_file);
+}
+
+static void *flush_records(void *arg)
+{
+    struct log_ring *ring = arg;
+
+    for (;;)
+    {
+        // Read before draining, records logged before the stop are kept
+        pthread_mutex_lock(&ring->lock);
+        bool stopping = ring->stopping;
+        pthread_mutex_unlock(&ring->lock);
+
+        if (drain_records(ring))
+            flush_files();
+        else if (stopping)
+            break;
+        else
+            wait_for_records(ring);
+    }
+
+    flush_files();
+    return NULL;
+}
+
+static struct log_ring *create_ring(const struct config *config)
+{
+    size_t capacity = 1;
+    while (capacity < config->log_buffer)
+        capacity <<= 1;
+
+    struct log_ring *ring = calloc(1, sizeof(struct log_ring));
+    if (!ring)
+        return NULL;
+    ring->records = calloc(capacity, sizeof(struct log_record));
+    if (!ring->records)
+    {
+        free(ring);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < capacity; i++)
+        ring->records[i].sequence = i;
+    ring->mask = capacity - 1;
+    ring->block = config->log_overflow == LOG_OVERFLOW_BLOCK;
+    ring->config = config;
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_cond_init(&ring->wakeup, NULL);
+
+    if (pthread_create(&ring->flusher, NULL, flush_records, ring))
+    {
+        pthread_cond_destroy(&ring->wakeup);
+        pthread_mutex_destroy(&ring->lock);
+        free(ring->records);
+        free(ring);
+        return NULL;
+    }
+
+    return ring;
+}
+
+static void destroy_ring(struct log_ring *ring)
+{
+    pthread_mutex_lock(&ring->lock);
+    ring->stopping = true;
+    pthread_cond_signal(&ring->wakeup);
+    pthread_mutex_unlock(&ring->lock);
+
+    pthread_join(ring->flusher, NULL);
+    pthread_cond_destroy(&ring->wakeup);
+    pthread_mutex_destroy(&ring->lock);
+    free(ring->records);
+    free(ring);
+}
+
+static FILE *open_access_log(const char *path)
+{
+    FILE *file = fopen(path, "ab");
+    if (!file)
+        return NULL;
+
+    // Records are appended to an existing log, a new one starts with the
+    // header
+    unsigned char header[ACCESS_LOG_HEADER_SIZE];
+    if (fseek(file, 0, SEEK_END) == 0 && ftell(file) == 0)
+        fwrite(header, 1, access_log_header(header), file);
+    return file;
+}
+
+int logger_init(const struct config *config)
+{
+    if (config->log)
+    {
+        log_file = config->log_file ? fopen(config->log_file, "w") : stdout;
+        if (!log_file)
+            return 1;
+    }
+
+    if (config->access_log)
+    {
+        access_file = open_access_log(config->access_log);
+        if (!access_file)
+            return 1;
+    }
+
+    // Log synchronously if the flusher cannot be started
+    if (config->log_buffer && (log_file || access_file))
+        ring = create_ring(config);
+
+    return 0;
+}
+
+void logger_log(const struct config *config, const char *message)
+{
+    if (!log_file || !config->log)
+        return;
+
+    struct log_record local;
+    struct log_record *record = begin_record(&local);
+    if (!record)
+        return;
+
+    size_t length = strlen(message);
+    record->kind = RECORD_MESSAGE;
+    record->length = length < LOG_TEXT_MAX ? length : LOG_TEXT_MAX;
+    memcpy(record->text, message, record->length);
+    end_record(config, record);
+}
+
+static void capture_request(struct log_record *record,
+                            const struct request_header *request,
+                            const struct string *client_ip)
+{
+    size_t ip_length = client_ip->size < INET_ADDRSTRLEN - 1
+        ? client_ip->size
+        : INET_ADDRSTRLEN - 1;
+    memcpy(record->client_ip, client_ip->data, ip_length);
+    record->client_ip[ip_length] = '\0';
+
+    record->status = request->status;
+    record->method = request->method;
+
+    // Keep log lines bounded, targets come straight from the client
+    record->length = request->target.size < TARGET_LOG_MAX
+        ? request->target.size
+        : TARGET_LOG_MAX;
+    if (record->length)
+        memcpy(record->text, request->target.data, record->length);
+}
+
+void logger_request(const struct config *config,
+                    const struct request_header *request,
+                    const struct string *client_ip)
+{
+    // Requests go to the binary access log instead when there is one
+    if (!log_file || !config->log || access_file)
+        return;
+
+    struct log_record local;
+    struct log_record *record = begin_record(&local);
+    if (!record)
+        return;
+
+    record->kind = RECORD_REQUEST;
+    capture_request(record, request, client_ip);
+    end_record(config, record);
+}
+
+void logger_response(const struct config *config,
+                     const struct request_header *request,
+                     const struct string *client_ip)
+{
+    if (!log_file || !config->log || access_file)
+        return;
+
+    struct log_record local;
+    struct log_record *record = begin_record(&local);
+    if (!record)
+        return;
+
+    record->kind = RECORD_RESPONSE;
+    capture_request(record, request, client_ip);
+    end_record(config, record);
+}
+
+void logger_access(const struct config *config,
+                   const struct request_header *request,
+                   const struct string *client_ip,
+                   const struct access_stats *stats)
+{
+    if (!access_file)
+        return;
+
+    struct log_record local;
+    struct log_record *record = begin_record(&local);
+    if (!record)
+        return;
+
+    record->kind = RECORD_ACCESS;
+    capture_request(record, request, client_ip);
+    record->stats = *stats;
+    end_record(config, record);
 }
 
 void logger_error(const struct config *config, const char *source,
@@ -134,15 +531,22 @@ void logger_error(const struct config *config, const char *source,
         return;
 
     char msg[512];
-    sprintf(msg, "An error occured in %s: %s", source, message);
+    snprintf(msg, sizeof(msg), "An error occured in %s: %s", source, message);
     logger_log(config, msg);
 }
 
 void logger_destroy(void)
 {
-    // Ensure all logs are flushed before closing
-    fflush(log_file);
+    // Write out every record logged so far before closing
+    if (ring)
+        destroy_ring(ring);
+    ring = NULL;
+
+    flush_files();
     if (log_file && log_file != stdout)
         fclose(log_file);
     log_file = NULL;
+    if (access_file)
+        fclose(access_file);
+    access_file = NULL;
 }
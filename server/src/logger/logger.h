@@ -1,9 +1,25 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include <stdint.h>
+
 #include "../config/config.h"
 #include "../http/http.h"
 
+/*
+** @brief What the binary access log records about a response besides its
+**        request
+**
+** @param bytes Number of bytes of the response, header and body
+** @param latency Microseconds between the first byte of the request and
+**        its response being queued
+*/
+struct access_stats
+{
+    uint64_t bytes;
+    uint32_t latency;
+};
+
 int logger_init(const struct config *config);
 void logger_log(const struct config *config, const char *message);
 void logger_request(const struct config *config,
@@ -12,6 +28,10 @@ void logger_request(const struct config *config,
 void logger_response(const struct config *config,
                      const struct request_header *request,
                      const struct string *client_ip);
+void logger_access(const struct config *config,
+                   const struct request_header *request,
+                   const struct string *client_ip,
+                   const struct access_stats *stats);
 void logger_error(const struct config *config, const char *source,
                   const char *message);
 void logger_destroy(void);
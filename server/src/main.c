@@ -75,8 +75,56 @@ void print_config(struct config *config)
     else
         logger_log(config, "Log File: (not set)");
 
+    if (config->access_log)
+    {
+        sprintf(msg, "Access Log: %s", config->access_log);
+        logger_log(config, msg);
+    }
+    else
+        logger_log(config, "Access Log: (not set)");
+
     sprintf(msg, "Log Enabled: %s", config->log ? "true" : "false");
     logger_log(config, msg);
+    sprintf(msg, "Log Buffer: %u", config->log_buffer);
+    logger_log(config, msg);
+    logger_log(config,
+               config->log_overflow == LOG_OVERFLOW_BLOCK
+                   ? "Log Overflow: block"
+                   : "Log Overflow: drop");
+
+    sprintf(msg, "Keep-Alive Timeout: %u", config->keep_alive_timeout);
+    logger_log(config, msg);
+    sprintf(msg, "Max Requests: %u", config->max_requests);
+    logger_log(config, msg);
+    sprintf(msg, "Workers: %u", config->workers);
+    logger_log(config, msg);
+    logger_log(config,
+               config->event_engine == IO_URING_ENGINE
+                   ? "Event Engine: io_uring"
+                   : "Event Engine: epoll");
+    sprintf(msg, "File Cache: %u", config->file_cache);
+    logger_log(config, msg);
+    sprintf(msg, "File Cache Memory: %u", config->file_cache_memory);
+    logger_log(config, msg);
+    sprintf(msg, "File Cache Max Body: %u", config->file_cache_max_body);
+    logger_log(config, msg);
+    sprintf(msg, "Max Connections: %u", config->max_connections);
+    logger_log(config, msg);
+    sprintf(msg, "TCP No Push: %s", config->tcp_nopush ? "true" : "false");
+    logger_log(config, msg);
+    sprintf(msg, "Precompressed: %s", config->precompressed ? "true" : "false");
+    logger_log(config, msg);
+    sprintf(msg, "Compress Cache: %u", config->compress_cache);
+    logger_log(config, msg);
+    sprintf(msg, "Compress Threads: %u", config->compress_threads);
+    logger_log(config, msg);
+    if (config->metrics_path)
+    {
+        sprintf(msg, "Metrics Path: %s", config->metrics_path);
+        logger_log(config, msg);
+    }
+    else
+        logger_log(config, "Metrics Path: (not set)");
 
     print_server_config(config);
 
@@ -109,6 +157,14 @@ void print_help(void)
     puts("\t--log <true|false>\t\tEnable logging (default: true)");
     puts("\t--log_file <path>\t\tRelative path to log file (default: "
          "HTTP.log if daemon option is used)");
+    puts("\t--access_log <path>\t\tLog requests in binary to this file, "
+         "read it\n\t\t\t\t\twith access-log-decode (default: text "
+         "lines in the\n\t\t\t\t\tlog)");
+    puts("\t--log_buffer <n>\t\tLines buffered for the logging thread, 0 "
+         "makes\n\t\t\t\t\tworkers write them themselves (default: "
+         "1024)");
+    puts("\t--log_overflow <drop|block>\tDrop lines or wait when the log "
+         "buffer is full\n\t\t\t\t\t(default: drop)");
     puts("\t--server_name <name>\t\tServer name (required)");
     puts("\t--port <port>\t\t\tServer port (required)");
     puts("\t--ip <address>\t\t\tServer IP address (required)");
@@ -116,6 +172,37 @@ void print_help(void)
          "(required)");
     puts("\t--default_file <name>\t\tDefault file to search when none is "
          "specified in\n\t\t\t\t\tquery (default: index.html)");
+    puts("\t--keep_alive_timeout <sec>\tSeconds an idle persistent connection "
+         "is kept\n\t\t\t\t\topen, 0 disables keep-alive (default: 5)");
+    puts("\t--max_requests <n>\t\tRequests served on a persistent "
+         "connection before\n\t\t\t\t\tclosing it, 0 means unlimited "
+         "(default: 100)");
+    puts("\t--workers <n>\t\t\tNumber of worker threads, 0 starts one per "
+         "CPU\n\t\t\t\t\t(default: 1)");
+    puts("\t--event_engine <epoll|io_uring>\tEvent loop used by the workers, "
+         "io_uring falls\n\t\t\t\t\tback to epoll when unsupported "
+         "(default: epoll)");
+    puts("\t--file_cache <n>\t\tOpen files each worker keeps cached, 0 "
+         "disables\n\t\t\t\t\tthe cache (default: 128)");
+    puts("\t--file_cache_memory <bytes>\tBytes of small file bodies each "
+         "worker keeps\n\t\t\t\t\tin memory (default: 8388608)");
+    puts("\t--file_cache_max_body <bytes>\tLargest file body kept in memory "
+         "(default:\n\t\t\t\t\t16384)");
+    puts("\t--max_connections <n>\t\tConnections each worker keeps open, "
+         "others are\n\t\t\t\t\trefused, 0 means unlimited (default: "
+         "1024)");
+    puts("\t--tcp_nopush <true|false>\tSend headers in the same segments as "
+         "the start\n\t\t\t\t\tof file bodies (default: true)");
+    puts("\t--precompressed <true|false>\tServe the .br, .zst or .gz file "
+         "next to a\n\t\t\t\t\tfile to clients accepting it (default: "
+         "false)");
+    puts("\t--compress_cache <bytes>\tCompressed files each worker keeps in "
+         "memory,\n\t\t\t\t\t0 disables compression (default: 0)");
+    puts("\t--compress_threads <n>\t\tThreads compressing files (default: "
+         "1)");
+    puts("\t--metrics_path <target>\t\tTarget answered with the server "
+         "metrics in\n\t\t\t\t\tPrometheus text format (default: "
+         "disabled)");
     puts(
         "\t--daemon <start|stop|restart>\tDaemon control option. Start "
         "returns an error when a daemon with\n"
@@ -182,5 +269,7 @@ int main(int argc, char **argv)
         return 0;
     }
 
+    // Write out the lines explaining why the server could not start
+    logger_destroy();
     return 1;
 }
@@ -0,0 +1,220 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "metrics.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static const int status_codes[METRICS_STATUS_CODES] = {
+    200, 206, 304, 400, 403, 404, 405, 414, 416, 500, 505
+};
+
+static const char *const phase_names[PHASE_COUNT] = { "accept", "parse",
+                                                      "open", "send" };
+
+static const char *const counter_help[COUNTER_COUNT][3] = {
+    { "httpd_connections_accepted_total", "counter",
+      "Connections accepted" },
+    { "httpd_connections_closed_total", "counter", "Connections closed" },
+    { "httpd_response_bytes_total", "counter",
+      "Bytes of the responses, header and body" },
+};
+
+static struct metrics *workers_metrics = NULL;
+static unsigned workers_count = 0;
+
+bool metrics_init(unsigned workers)
+{
+    workers_metrics = calloc(workers, sizeof(struct metrics));
+    if (!workers_metrics)
+        return false;
+
+    workers_count = workers;
+    return true;
+}
+
+struct metrics *metrics_of(unsigned worker)
+{
+    return worker < workers_count ? &workers_metrics[worker] : NULL;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Only the owning worker writes, a plain load and store is enough for the
+// readers to see whole values
+static void add(uint64_t *counter, uint64_t n)
+{
+    uint64_t value = __atomic_load_n(counter, __ATOMIC_RELAXED);
+    __atomic_store_n(counter, value + n, __ATOMIC_RELAXED);
+}
+
+static uint64_t load(const uint64_t *counter)
+{
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+uint64_t metrics_start(const struct metrics *metrics)
+{
+    return metrics ? now_ns() : 0;
+}
+
+void metrics_observe(struct metrics *metrics, enum metrics_phase phase,
+                     uint64_t start)
+{
+    if (!metrics)
+        return;
+
+    uint64_t duration = now_ns() - start;
+    unsigned bits = duration ? 64 - __builtin_clzll(duration) : 0;
+    unsigned bucket = bits > METRICS_MIN_SHIFT ? bits - METRICS_MIN_SHIFT : 0;
+    if (bucket >= METRICS_BUCKETS)
+        bucket = METRICS_BUCKETS - 1;
+
+    struct histogram *histogram = &metrics->phases[phase];
+    add(&histogram->buckets[bucket], 1);
+    add(&histogram->sum, duration);
+}
+
+void metrics_count(struct metrics *metrics, enum metrics_counter counter,
+                   uint64_t n)
+{
+    if (metrics)
+        add(&metrics->counters[counter], n);
+}
+
+void metrics_status(struct metrics *metrics, int status)
+{
+    if (!metrics)
+        return;
+
+    unsigned i = 0;
+    while (i < METRICS_STATUS_CODES && status_codes[i] != status)
+        i++;
+    add(&metrics->statuses[i], 1);
+}
+
+static void sum_metrics(struct metrics *total)
+{
+    for (unsigned w = 0; w < workers_count; w++)
+    {
+        const struct metrics *metrics = &workers_metrics[w];
+        for (int i = 0; i < COUNTER_COUNT; i++)
+            total->counters[i] += load(&metrics->counters[i]);
+        for (int i = 0; i <= METRICS_STATUS_CODES; i++)
+            total->statuses[i] += load(&metrics->statuses[i]);
+
+        for (int p = 0; p < PHASE_COUNT; p++)
+        {
+            const struct histogram *histogram = &metrics->phases[p];
+            for (int i = 0; i < METRICS_BUCKETS; i++)
+                total->phases[p].buckets[i] += load(&histogram->buckets[i]);
+            total->phases[p].sum += load(&histogram->sum);
+        }
+    }
+}
+
+/*
+** @brief Text being rendered, writes past size are counted but dropped
+*/
+struct render
+{
+    char *buffer;
+    size_t size;
+    size_t length;
+};
+
+static void append(struct render *render, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    size_t left = render->length < render->size
+        ? render->size - render->length
+        : 0;
+    int n = vsnprintf(render->buffer + render->size - left, left, format,
+                      args);
+    va_end(args);
+    if (n > 0)
+        render->length += n;
+}
+
+static void render_counters(struct render *render,
+                            const struct metrics *total)
+{
+    for (int i = 0; i < COUNTER_COUNT; i++)
+        append(render, "# HELP %s %s\n# TYPE %s %s\n%s %llu\n",
+               counter_help[i][0], counter_help[i][2], counter_help[i][0],
+               counter_help[i][1], counter_help[i][0],
+               (unsigned long long)total->counters[i]);
+
+    append(render,
+           "# HELP httpd_connections_active Connections open\n"
+           "# TYPE httpd_connections_active gauge\n"
+           "httpd_connections_active %llu\n",
+           (unsigned long long)(total->counters[COUNTER_ACCEPTED]
+                                - total->counters[COUNTER_CLOSED]));
+
+    append(render,
+           "# HELP httpd_responses_total Responses by status code\n"
+           "# TYPE httpd_responses_total counter\n");
+    for (int i = 0; i < METRICS_STATUS_CODES; i++)
+        append(render, "httpd_responses_total{code=\"%d\"} %llu\n",
+               status_codes[i], (unsigned long long)total->statuses[i]);
+    append(render, "httpd_responses_total{code=\"other\"} %llu\n",
+           (unsigned long long)total->statuses[METRICS_STATUS_CODES]);
+}
+
+static void render_histogram(struct render *render, const char *phase,
+                             const struct histogram *histogram)
+{
+    uint64_t count = 0;
+    for (int i = 0; i < METRICS_BUCKETS - 1; i++)
+    {
+        count += histogram->buckets[i];
+        double bound = (double)(1ULL << (i + METRICS_MIN_SHIFT)) / 1e9;
+        append(render,
+               "httpd_phase_duration_seconds_bucket{phase=\"%s\",le=\"%g\"}"
+               " %llu\n",
+               phase, bound, (unsigned long long)count);
+    }
+
+    count += histogram->buckets[METRICS_BUCKETS - 1];
+    append(render,
+           "httpd_phase_duration_seconds_bucket{phase=\"%s\",le=\"+Inf\"} "
+           "%llu\n"
+           "httpd_phase_duration_seconds_sum{phase=\"%s\"} %.9f\n"
+           "httpd_phase_duration_seconds_count{phase=\"%s\"} %llu\n",
+           phase, (unsigned long long)count, phase, histogram->sum / 1e9,
+           phase, (unsigned long long)count);
+}
+
+size_t metrics_render(char *buffer, size_t size)
+{
+    struct metrics total = { 0 };
+    sum_metrics(&total);
+
+    struct render render = { buffer, size, 0 };
+    render_counters(&render, &total);
+
+    append(&render,
+           "# HELP httpd_phase_duration_seconds Duration of each phase of "
+           "the requests\n"
+           "# TYPE httpd_phase_duration_seconds histogram\n");
+    for (int p = 0; p < PHASE_COUNT; p++)
+        render_histogram(&render, phase_names[p], &total.phases[p]);
+
+    return render.length < size ? render.length : size - 1;
+}
+
+void metrics_destroy(void)
+{
+    free(workers_metrics);
+    workers_metrics = NULL;
+    workers_count = 0;
+}
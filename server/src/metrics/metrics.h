@@ -0,0 +1,119 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Bucket i of a histogram counts durations under 2^(i + METRICS_MIN_SHIFT)
+// nanoseconds, the last one everything longer
+#define METRICS_MIN_SHIFT 8
+#define METRICS_BUCKETS 28
+// Size of the Prometheus text rendered by metrics_render
+#define METRICS_BODY_MAX 16384
+
+/*
+** @brief Enum metrics_phase
+** PHASE_ACCEPT accepting a connection and setting it up, only the set up
+** with io_uring which accepts in the kernel
+** PHASE_PARSE parsing a request, from its last bytes to its fields
+** PHASE_OPEN finding the requested file
+** PHASE_SEND from a response being queued to its last byte being sent
+*/
+enum metrics_phase
+{
+    PHASE_ACCEPT,
+    PHASE_PARSE,
+    PHASE_OPEN,
+    PHASE_SEND,
+    PHASE_COUNT
+};
+
+/*
+** @brief Durations in power of two buckets, like HdrHistogram without its
+**        sub-buckets
+**
+** @param buckets Number of durations in each bucket
+** @param sum Total of the durations, in nanoseconds
+*/
+struct histogram
+{
+    uint64_t buckets[METRICS_BUCKETS];
+    uint64_t sum;
+};
+
+/*
+** @brief Enum metrics_counter
+** COUNTER_ACCEPTED connections accepted
+** COUNTER_CLOSED connections closed
+** COUNTER_BYTES bytes of the queued responses, header and body
+*/
+enum metrics_counter
+{
+    COUNTER_ACCEPTED,
+    COUNTER_CLOSED,
+    COUNTER_BYTES,
+    COUNTER_COUNT
+};
+
+// Status codes counted separately, the others are counted as "other"
+#define METRICS_STATUS_CODES 11
+
+/*
+** @brief Counters of one worker. Only the worker writes them, with plain
+**        relaxed stores, and metrics_render reads them from any thread
+**
+** @param counters Values of each enum metrics_counter
+** @param statuses Responses by status code, see metrics_status
+** @param phases Durations of each phase of a request
+*/
+struct metrics
+{
+    uint64_t counters[COUNTER_COUNT];
+    uint64_t statuses[METRICS_STATUS_CODES + 1];
+    struct histogram phases[PHASE_COUNT];
+};
+
+/*
+** @brief Allocate the metrics of every worker, they are collected only once
+**        this succeeded
+*/
+bool metrics_init(unsigned workers);
+
+/*
+** @return the metrics of a worker, NULL when they are not collected
+*/
+struct metrics *metrics_of(unsigned worker);
+
+/*
+** @return the start of a phase, 0 when metrics is NULL
+*/
+uint64_t metrics_start(const struct metrics *metrics);
+
+/*
+** @brief Record the duration of a phase started at start
+*/
+void metrics_observe(struct metrics *metrics, enum metrics_phase phase,
+                     uint64_t start);
+
+/*
+** @brief Add n to a counter, nothing is counted when metrics is NULL
+*/
+void metrics_count(struct metrics *metrics, enum metrics_counter counter,
+                   uint64_t n);
+
+/*
+** @brief Count a response with the given status code
+*/
+void metrics_status(struct metrics *metrics, int status);
+
+/*
+** @brief Sum the metrics of every worker in Prometheus text format
+**
+** @return the length of the text, at most size - 1
+*/
+size_t metrics_render(char *buffer, size_t size);
+
+void metrics_destroy(void);
+
+#endif /* ! METRICS_H */
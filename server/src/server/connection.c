@@ -0,0 +1,369 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "connection.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../logger/logger.h"
+
+/*
+** @brief Connections allocated at once by a pool
+*/
+struct connection_slab
+{
+    struct connection_slab *next;
+    size_t count;
+    struct connection connections[];
+};
+
+struct connection_pool *connection_pool_create(size_t capacity)
+{
+    struct connection_pool *pool = calloc(1, sizeof(struct connection_pool));
+    if (pool)
+        pool->capacity = capacity;
+    return pool;
+}
+
+static bool grow_pool(struct connection_pool *pool)
+{
+    size_t count = CONNECTION_SLAB_SIZE;
+    if (pool->capacity && pool->capacity - pool->allocated < count)
+        count = pool->capacity - pool->allocated;
+
+    struct connection_slab *slab = calloc(
+        1, sizeof(struct connection_slab) + count * sizeof(struct connection));
+    if (!slab)
+        return false;
+
+    // Allocate the receive buffers up front, they are reused by every
+    // client of the connection
+    for (size_t i = 0; i < count; i++)
+    {
+        struct connection *connection = &slab->connections[i];
+        connection->request = string_create("", 0);
+        if (!connection->request
+            || !string_reserve(connection->request, CONNECTION_BUFFER_SIZE))
+        {
+            for (size_t j = 0; j <= i; j++)
+                string_destroy(slab->connections[j].request);
+            free(slab);
+            return false;
+        }
+        arena_init(&connection->arena, CONNECTION_ARENA_BLOCK);
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        slab->connections[i].next = pool->free;
+        pool->free = &slab->connections[i];
+    }
+
+    slab->count = count;
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->allocated += count;
+    return true;
+}
+
+struct connection *create_connection(struct connection_pool *pool, int fd,
+                                     const char *ip)
+{
+    // Refuse clients beyond the capacity rather than growing the pool
+    bool full = pool->capacity && pool->allocated == pool->capacity;
+    if (!pool->free && (full || !grow_pool(pool)))
+        return NULL;
+
+    struct connection *connection = pool->free;
+    pool->free = connection->next;
+    pool->used++;
+    metrics_count(pool->metrics, COUNTER_ACCEPTED, 1);
+
+    connection->fd = fd;
+    strncpy(connection->sender_ip, ip, INET_ADDRSTRLEN - 1);
+    connection->sender.data = connection->sender_ip;
+    connection->sender.size = strlen(connection->sender_ip);
+    http_parser_init(&connection->parser);
+    connection->requests = 0;
+    connection->last_active = time(NULL);
+    connection->received_at = 0;
+    connection->closing = false;
+    connection->writing = false;
+    connection->queued = 0;
+    connection->metrics_body = (struct string){ 0 };
+    connection->metrics = pool->metrics;
+    connection->uring = NULL;
+    connection->prev = NULL;
+    connection->next = NULL;
+    return connection;
+}
+
+static void destroy_pending_response(struct pending_response *response)
+{
+    // Header and response themselves live in the connection's arena
+    file_cache_release(response->file);
+}
+
+void free_connection(struct connection_pool *pool,
+                     struct connection *connection)
+{
+    if (!connection)
+        return;
+
+    while (connection->responses)
+    {
+        struct pending_response *next = connection->responses->next;
+        destroy_pending_response(connection->responses);
+        connection->responses = next;
+    }
+    connection->last_response = NULL;
+    connection->queued = 0;
+
+    if (connection->fd != -1)
+        close(connection->fd);
+
+    // Keep the buffers for the next client, but not the memory a burst of
+    // requests or responses needed
+    string_shrink(connection->request, CONNECTION_BUFFER_SIZE);
+    arena_trim(&connection->arena);
+    if (connection->arena.first
+        && connection->arena.first->size > CONNECTION_ARENA_BLOCK)
+        arena_destroy(&connection->arena);
+    connection->next = pool->free;
+    pool->free = connection;
+    pool->used--;
+    metrics_count(pool->metrics, COUNTER_CLOSED, 1);
+}
+
+void connection_pool_destroy(struct connection_pool *pool)
+{
+    if (!pool)
+        return;
+
+    while (pool->slabs)
+    {
+        struct connection_slab *slab = pool->slabs;
+        for (size_t i = 0; i < slab->count; i++)
+        {
+            string_destroy(slab->connections[i].request);
+            arena_destroy(&slab->connections[i].arena);
+        }
+
+        pool->slabs = slab->next;
+        free(slab);
+    }
+
+    free(pool);
+}
+
+bool queue_response(struct connection *connection,
+                    struct header_parts *header,
+                    const struct response_body *body)
+{
+    struct pending_response *response =
+        arena_alloc(&connection->arena, sizeof(struct pending_response));
+    if (!response)
+        return false;
+
+    memset(response, 0, sizeof(struct pending_response));
+    response->header = header;
+    response->file = body->file;
+    response->body = body->file ? body->file->body : body->data;
+    response->offset = body->offset;
+    response->remaining = body->file || body->data ? body->length : 0;
+    response->part = body->part && connection->last_response;
+
+    // Parts are timed with the response they belong to
+    response->queued_at = response->part
+        ? connection->last_response->queued_at
+        : metrics_start(connection->metrics);
+
+    // Append at the tail to answer requests in order
+    if (connection->last_response)
+        connection->last_response->next = response;
+    else
+        connection->responses = response;
+    connection->last_response = response;
+    connection->queued++;
+    return true;
+}
+
+static bool is_sent(const struct pending_response *response)
+{
+    return response->header_sent == response->header->size
+        && response->remaining == 0;
+}
+
+void pop_sent_responses(struct connection *connection)
+{
+    while (connection->responses && is_sent(connection->responses))
+    {
+        struct pending_response *next = connection->responses->next;
+        if (!next || !next->part)
+            metrics_observe(connection->metrics, PHASE_SEND,
+                            connection->responses->queued_at);
+        destroy_pending_response(connection->responses);
+        connection->responses = next;
+        connection->queued--;
+    }
+
+    // Nothing allocated in the arena is used anymore
+    if (!connection->responses)
+    {
+        connection->last_response = NULL;
+        connection->metrics_body = (struct string){ 0 };
+        arena_reset(&connection->arena);
+    }
+}
+
+static size_t gather_header(const struct pending_response *response,
+                            struct iovec *iov)
+{
+    const struct header_parts *header = response->header;
+    size_t skip = response->header_sent;
+    size_t count = 0;
+
+    // Skip the parts already sent
+    for (size_t i = 0; i < header->count; i++)
+    {
+        const struct iovec *part = &header->parts[i];
+        if (skip >= part->iov_len)
+        {
+            skip -= part->iov_len;
+            continue;
+        }
+
+        iov[count].iov_base = (char *)part->iov_base + skip;
+        iov[count++].iov_len = part->iov_len - skip;
+        skip = 0;
+    }
+
+    return count;
+}
+
+size_t gather_buffers(const struct connection *connection, struct iovec *iov,
+                      size_t max, struct pending_response **file_body)
+{
+    size_t count = 0;
+    if (file_body)
+        *file_body = NULL;
+
+    // Gather unsent headers and in memory bodies up to the first response
+    // whose body is sent from its file
+    for (struct pending_response *r = connection->responses;
+         r && count + HEADER_PARTS_MAX + 1 <= max; r = r->next)
+    {
+        count += gather_header(r, iov + count);
+
+        if (r->remaining > 0 && !r->body)
+        {
+            if (file_body)
+                *file_body = r;
+            break;
+        }
+        if (r->remaining > 0)
+        {
+            iov[count].iov_base = (char *)r->body + r->offset;
+            iov[count++].iov_len = r->remaining;
+        }
+    }
+
+    return count;
+}
+
+void account_sent_buffers(struct connection *connection, size_t sent)
+{
+    // Account sent bytes to the gathered buffers, in order
+    for (struct pending_response *r = connection->responses; sent;
+         r = r->next)
+    {
+        size_t n = r->header->size - r->header_sent;
+        n = n < sent ? n : sent;
+        r->header_sent += n;
+        sent -= n;
+
+        if (!r->body)
+            continue;
+
+        n = (size_t)r->remaining < sent ? (size_t)r->remaining : sent;
+        r->offset += n;
+        r->remaining -= n;
+        sent -= n;
+    }
+}
+
+static ssize_t send_buffers(struct connection *connection, bool nopush)
+{
+    struct iovec iov[MAX_BATCH];
+    struct msghdr msg = { 0 };
+    struct pending_response *file_body = NULL;
+    msg.msg_iov = iov;
+    msg.msg_iovlen = gather_buffers(connection, iov, MAX_BATCH, &file_body);
+
+    // Hold the header back so that it shares its segments with the start
+    // of the body sendfile() sends right after
+    int flags = MSG_NOSIGNAL;
+    if (file_body && nopush)
+        flags |= MSG_MORE;
+
+    ssize_t sent = sendmsg(connection->fd, &msg, flags);
+    if (sent > 0)
+        account_sent_buffers(connection, sent);
+
+    return sent;
+}
+
+static ssize_t send_body(struct connection *connection)
+{
+    struct pending_response *response = connection->responses;
+
+    ssize_t sent = sendfile(connection->fd, response->file->fd,
+                            &response->offset, response->remaining);
+    if (sent > 0)
+        response->remaining -= sent;
+
+    // File got shorter since its size was read, the Content-Length sent
+    // cannot be honoured and the client would read what follows as body
+    if (sent == 0)
+    {
+        errno = ENODATA;
+        return -1;
+    }
+
+    return sent;
+}
+
+int flush_responses(const struct config *config, struct connection *connection)
+{
+    while (connection->responses)
+    {
+        struct pending_response *response = connection->responses;
+        bool in_memory = response->header_sent < response->header->size
+            || response->body;
+
+        ssize_t sent = in_memory ? send_buffers(connection, config->tcp_nopush)
+                                 : send_body(connection);
+        if (sent == -1)
+        {
+            // Interrupted by signal, try again
+            if (errno == EINTR)
+                continue;
+
+            // Socket buffer is full, wait for it to be writable again
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 1;
+
+            logger_error(config, in_memory ? "sendmsg()" : "sendfile()",
+                         strerror(errno));
+            return -1;
+        }
+
+        pop_sent_responses(connection);
+    }
+
+    return 0;
+}
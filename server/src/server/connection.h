@@ -0,0 +1,243 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <time.h>
+
+#include "../config/config.h"
+#include "../http/http.h"
+#include "../metrics/metrics.h"
+#include "../utils/arena/arena.h"
+#include "../utils/file/file_cache.h"
+#include "../utils/string/string.h"
+
+// Maximum number of buffers sent in a single call
+#define MAX_BATCH 64
+// Pooled connections keep at most sizeof(struct connection), a receive
+// buffer of CONNECTION_BUFFER_SIZE bytes and one arena block of
+// CONNECTION_ARENA_BLOCK bytes, the pool is bounded by max_connections times
+// that. Anything more a client needed is freed with its connection
+
+// Size of the blocks of the connection arenas, enough for a few pipelined
+// responses
+#define CONNECTION_ARENA_BLOCK 4096
+// Receive buffer allocated with each pooled connection
+#define CONNECTION_BUFFER_SIZE 4096
+// Most bytes buffered by a connection, reading stops until they are handled
+#define CONNECTION_BUFFER_MAX (4 * REQUEST_HEADER_MAX)
+// Number of connections allocated at once by a pool
+#define CONNECTION_SLAB_SIZE 64
+
+struct uring_connection;
+
+/*
+** @brief Response waiting to be sent on a connection
+**
+** @param header Serialized response header, in the connection's arena
+** @param header_sent Number of header bytes already sent
+** @param file File sent as body after the header, NULL if none
+** @param body Content of file when it is kept in memory, sent along with the
+**        header instead of with sendfile
+** @param offset Offset of the next body byte to send
+** @param remaining Number of body bytes left to send
+** @param queued_at When the response was queued, see metrics_start
+** @param part Part of the multipart body of the response queued before it
+** @param next Next queued response
+*/
+struct pending_response
+{
+    struct header_parts *header;
+    size_t header_sent;
+    struct cached_file *file;
+    const char *body;
+    off_t offset;
+    off_t remaining;
+    uint64_t queued_at;
+    bool part;
+    struct pending_response *next;
+};
+
+/*
+** @brief Body of a response, sent from a cached file or from memory
+**
+** @param file File to send, NULL if none
+** @param data Body kept in memory, used when file is NULL
+** @param offset Offset of the first byte sent
+** @param length Number of bytes of the body
+** @param ranges Ranges of file sent as a multipart body when there are
+**        several, a single range is sent with offset and length
+** @param part The body is a part of the multipart body of the response
+**        queued before it
+** @param encoding Content coding of file, NULL for none
+** @param vary file was chosen from the Accept-Encoding of the request
+*/
+struct response_body
+{
+    struct cached_file *file;
+    const char *data;
+    off_t offset;
+    off_t length;
+    const struct byte_range *ranges;
+    size_t range_count;
+    bool part;
+    const char *encoding;
+    bool vary;
+};
+
+/*
+** @brief Client connection
+**
+** @param fd Client socket
+** @param sender Client IPv4 address, a view of sender_ip
+** @param request Received data of the requests not handled yet, its memory
+**        is kept when the connection goes back to its pool
+** @param parser State of the parser on the first request of request
+** @param parsed Request being handled, reused by every request of the
+**        connection
+** @param requests Number of requests served on this connection
+** @param last_active Last time data was exchanged with the client
+** @param received_at When the first byte of the request being parsed was
+**        received, in microseconds of CLOCK_MONOTONIC, 0 if none is buffered
+** @param closing Connection is closed once its queued responses are sent
+** @param writing Waiting for the socket to be writable to send responses
+** @param responses Responses to send, in the order requests were received
+** @param last_response Tail of the responses queue
+** @param queued Number of responses queued, parts of multipart bodies
+**        included
+** @param arena Memory of the queued responses, reset once they are all sent
+** @param metrics_body Metrics rendered in arena, shared by the metrics
+**        responses queued until then, empty if none is queued
+** @param metrics Metrics of the worker owning the connection, can be NULL
+** @param uring io_uring engine state, NULL with the epoll engine
+*/
+struct connection
+{
+    int fd;
+    struct string sender;
+    char sender_ip[INET_ADDRSTRLEN];
+    struct string *request;
+    struct http_parser parser;
+    struct request_header parsed;
+    unsigned requests;
+    time_t last_active;
+    uint64_t received_at;
+    bool closing;
+    bool writing;
+
+    struct pending_response *responses;
+    struct pending_response *last_response;
+    size_t queued;
+    struct arena arena;
+    struct string metrics_body;
+    struct metrics *metrics;
+    struct uring_connection *uring;
+
+    struct connection *prev;
+    struct connection *next;
+};
+
+struct connection_slab;
+
+/*
+** @brief Free list of connections carved from slabs of CONNECTION_SLAB_SIZE
+**        connections, with their receive buffer and arena kept between uses.
+**        Not thread safe, each worker owns one
+**
+** @param free Connections ready to be used, the most recently freed first
+** @param slabs Every slab allocated, freed with the pool
+** @param used Number of connections in use
+** @param allocated Number of connections in the slabs
+** @param capacity Maximum number of connections in use at once, 0 means
+**        unlimited
+** @param metrics Metrics of the worker owning the pool, can be NULL
+*/
+struct connection_pool
+{
+    struct connection *free;
+    struct connection_slab *slabs;
+    size_t used;
+    size_t allocated;
+    size_t capacity;
+    struct metrics *metrics;
+};
+
+struct connection_pool *connection_pool_create(size_t capacity);
+
+/*
+** @brief Free the pool and every connection it allocated, none must be in
+**        use anymore
+*/
+void connection_pool_destroy(struct connection_pool *pool);
+
+/*
+** @brief Take a connection from the pool for the client socket fd
+**
+** @param ip Client IPv4 address
+**
+** @return the connection, NULL if the pool is at its capacity or out of
+**         memory
+*/
+struct connection *create_connection(struct connection_pool *pool, int fd,
+                                     const char *ip);
+
+/*
+** @brief Close the connection and give it back to its pool
+*/
+void free_connection(struct connection_pool *pool,
+                     struct connection *connection);
+
+/*
+** @brief Append a response to the connection's queue. The connection takes
+**        ownership of the reference to body->file, header and body->data
+**        must be allocated in the connection's arena
+**
+** @param connection
+** @param header Serialized response header
+** @param body Body to send after the header, none if it has no file nor data
+**
+** @return false if the response could not be allocated
+*/
+bool queue_response(struct connection *connection,
+                    struct header_parts *header,
+                    const struct response_body *body);
+
+/*
+** @brief Fill iov with the unsent headers and in memory bodies of the queued
+**        responses, stopping after the first response with a body to send
+**        from its file
+**
+** @param file_body Set to the response whose header was gathered last when
+**        its body is sent from its file, NULL otherwise. Can be NULL
+**
+** @return the number of iovec filled
+*/
+size_t gather_buffers(const struct connection *connection, struct iovec *iov,
+                      size_t max, struct pending_response **file_body);
+
+/*
+** @brief Mark sent bytes of the buffers gathered by gather_buffers as sent
+*/
+void account_sent_buffers(struct connection *connection, size_t sent);
+
+/*
+** @brief Free the responses at the head of the queue that were fully sent,
+**        resetting the arena when none is left
+*/
+void pop_sent_responses(struct connection *connection);
+
+/*
+** @brief Send the queued responses in order, batching consecutive headers
+**        and in memory bodies in a single call. Sending stops as soon as the
+**        socket would block and resumes from the same point on the next call
+**
+** @return 0 if every queued response was sent, 1 if the socket would block,
+**         -1 on error or if a file got shorter than the length announced
+*/
+int flush_responses(const struct config *config,
+                    struct connection *connection);
+
+#endif /* ! CONNECTION_H */
@@ -0,0 +1,375 @@
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../config/config.h"
+#include "../logger/logger.h"
+#include "../utils/string/string.h"
+#include "connection.h"
+#include "handler.h"
+#include "worker.h"
+
+#define MAX_EVENTS 1024
+#define IDLE_CHECK_INTERVAL_MS 1000
+#define RECV_CHUNK_SIZE 4096
+
+static int set_nonblocking(int fd)
+{
+    // Get current flags
+    int flags = fcntl(fd, F_GETFL, 0);
+
+    if (flags == -1)
+        return -1;
+
+    // Add non blocking flag
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static int receive_client_data(const struct config *config,
+                               struct connection *connection)
+{
+    struct string *request = connection->request;
+    ssize_t n;
+    int received = 0;
+
+    while (!shutting_down())
+    {
+        // Leave the rest in the socket until the buffered requests are
+        // handled, it is read on the next event
+        if (request->size >= CONNECTION_BUFFER_MAX)
+            return received;
+
+        // Receive straight into the request buffer, it keeps its memory
+        // between requests
+        if (!string_reserve(request, RECV_CHUNK_SIZE))
+        {
+            logger_error(config, "recv()", strerror(ENOMEM));
+            return -1;
+        }
+        size_t room = request->capacity - request->size;
+        if (room > CONNECTION_BUFFER_MAX - request->size)
+            room = CONNECTION_BUFFER_MAX - request->size;
+        n = recv(connection->fd, request->data + request->size, room, 0);
+
+        // Data received
+        if (n > 0)
+        {
+            connection->last_active = time(NULL);
+            request->size += n;
+            received = 1;
+            continue;
+        }
+
+        // No data to receive from client anymore
+        if (n == 0)
+            return -1;
+
+        if (n == -1)
+        {
+            // Everything available was read, parse what was received
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return received;
+
+            // Interrupt signal received
+            if (errno == EINTR)
+                continue;
+
+            logger_error(config, "recv()", strerror(errno));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void accept_and_register(struct worker *worker)
+{
+    struct config *config = worker->config;
+
+    while (!shutting_down())
+    {
+        uint64_t start = metrics_start(worker->metrics);
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        int cfd = accept(worker->sfd, &addr, &addr_len);
+        if (cfd == -1)
+        {
+            // No more incoming connections to accept
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+
+            // Interrupted by signal
+            if (errno == EINTR)
+                continue;
+
+            logger_error(config, "accept()", strerror(errno));
+            break;
+        }
+
+        // Set connection to non blocking
+        if (set_nonblocking(cfd) == -1)
+        {
+            close(cfd);
+            continue;
+        }
+
+        // Get client IPv4 address
+        char ip_str[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr.sin_addr, ip_str, sizeof(ip_str));
+
+        // Too many clients already, turn this one away
+        struct connection *connection =
+            create_connection(worker->pool, cfd, ip_str);
+        if (!connection)
+        {
+            close(cfd);
+            continue;
+        }
+
+        struct epoll_event conn_event;
+        conn_event.events = EPOLLIN | EPOLLRDHUP;
+        conn_event.data.ptr = connection;
+
+        // Register new connection
+        if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, cfd, &conn_event) == -1)
+        {
+            free_connection(worker->pool, connection);
+            continue;
+        }
+        track_connection(worker, connection);
+        metrics_observe(worker->metrics, PHASE_ACCEPT, start);
+    }
+}
+
+static int register_fd(int epfd, int fd, void *ptr)
+{
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = ptr;
+
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &event);
+}
+
+static int setup_epoll(struct worker *worker)
+{
+    struct config *config = worker->config;
+
+    // Set listening socket to non blocking
+    if (set_nonblocking(worker->sfd) == -1)
+    {
+        logger_error(config, "set_nonblocking()", strerror(errno));
+        return -1;
+    }
+
+    // Create epoll instance
+    int epfd = epoll_create1(0);
+    if (epfd == -1)
+    {
+        logger_error(config, "epoll_create1()", strerror(errno));
+        return -1;
+    }
+
+    // Register listening socket and shutdown notifications
+    if (register_fd(epfd, worker->sfd, NULL) == -1
+        || register_fd(epfd, worker->wakeup_fd, &worker->wakeup_fd) == -1)
+    {
+        logger_error(config, "epoll_ctl ADD listen", strerror(errno));
+        close(epfd);
+        return -1;
+    }
+
+    return epfd;
+}
+
+static void close_connection(struct worker *worker,
+                             struct connection *connection)
+{
+    epoll_ctl(worker->epfd, EPOLL_CTL_DEL, connection->fd, NULL);
+    untrack_connection(worker, connection);
+    free_connection(worker->pool, connection);
+}
+
+static int watch_events(int epfd, struct connection *connection,
+                        uint32_t events)
+{
+    struct epoll_event event;
+    event.events = events | EPOLLRDHUP;
+    event.data.ptr = connection;
+
+    return epoll_ctl(epfd, EPOLL_CTL_MOD, connection->fd, &event);
+}
+
+// Return false if the connection was closed
+static bool send_responses(struct worker *worker,
+                           struct connection *connection)
+{
+    int flushed = flush_responses(worker->config, connection);
+
+    // Error or every response sent on a non persistent connection
+    if (flushed == -1 || (flushed == 0 && connection->closing))
+    {
+        close_connection(worker, connection);
+        return false;
+    }
+
+    // Wait for the socket to be writable again to resume sending, stop
+    // reading new requests meanwhile
+    bool writing = flushed == 1;
+    if (writing != connection->writing)
+    {
+        if (watch_events(worker->epfd, connection,
+                         writing ? EPOLLOUT : EPOLLIN)
+            == -1)
+        {
+            logger_error(worker->config, "epoll_ctl MOD", strerror(errno));
+            close_connection(worker, connection);
+            return false;
+        }
+        connection->writing = writing;
+    }
+    return true;
+}
+
+// Answer the buffered requests a batch at a time, no event comes for the
+// ones left once a batch is sent
+static void answer_requests(struct worker *worker,
+                            struct connection *connection)
+{
+    bool left;
+    do
+    {
+        left = process_requests(worker, connection);
+        if (!send_responses(worker, connection))
+            return;
+    } while (left && !connection->writing);
+}
+
+static void handle_event(struct worker *worker,
+                         const struct epoll_event *event)
+{
+    struct connection *connection = event->data.ptr;
+
+    // Error occured in event
+    if (event->events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP))
+    {
+        close_connection(worker, connection);
+        return;
+    }
+
+    // Socket writable again, resume sending pending responses
+    if (event->events & EPOLLOUT)
+    {
+        connection->last_active = time(NULL);
+        if (send_responses(worker, connection) && !connection->writing
+            && connection->request->size)
+            answer_requests(worker, connection);
+        return;
+    }
+
+    // Process received data
+    if (event->events & EPOLLIN)
+    {
+        int received = receive_client_data(worker->config, connection);
+        if (received == -1)
+            close_connection(worker, connection);
+        else if (received == 1)
+        {
+            // Parse what was received, answer complete requests at once
+            answer_requests(worker, connection);
+        }
+    }
+}
+
+static uint64_t monotonic_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void close_idle_connections(struct worker *worker)
+{
+    time_t now = time(NULL);
+    struct connection *connection = worker->connections;
+
+    while (connection)
+    {
+        struct connection *next = connection->next;
+        if (now - connection->last_active
+            >= worker->config->keep_alive_timeout)
+            close_connection(worker, connection);
+
+        connection = next;
+    }
+}
+
+static void close_all_connections(struct worker *worker)
+{
+    while (worker->connections)
+        close_connection(worker, worker->connections);
+}
+
+int run_epoll_worker(struct worker *worker)
+{
+    struct config *config = worker->config;
+
+    worker->epfd = setup_epoll(worker);
+    if (worker->epfd == -1)
+        return -1;
+
+    // Wake up regularly to close idle persistent connections
+    int timeout = config->keep_alive_timeout ? IDLE_CHECK_INTERVAL_MS : -1;
+    uint64_t last_sweep = monotonic_ms();
+
+    struct epoll_event events[MAX_EVENTS];
+    while (!shutting_down())
+    {
+        int n = epoll_wait(worker->epfd, events, MAX_EVENTS, timeout);
+        if (n == -1)
+        {
+            // If interrupted by a signal, go to next iteration
+            if (errno == EINTR)
+                continue;
+
+            logger_error(config, "epoll_wait()", strerror(errno));
+            break;
+        }
+
+        // Responses to the events below share the same Date
+        http_date_update(&worker->date, time(NULL));
+        for (int i = 0; i < n; ++i)
+        {
+            // Shutdown requested, loop condition ends the worker
+            if (events[i].data.ptr == &worker->wakeup_fd)
+                continue;
+
+            // Register incoming connection
+            if (events[i].data.ptr == NULL)
+                accept_and_register(worker);
+            else
+                handle_event(worker, &events[i]);
+        }
+
+        // Busy workers wake up far more often than the interval, walking
+        // every connection each time would cost more than the events
+        uint64_t now = monotonic_ms();
+        if (timeout != -1 && now - last_sweep >= IDLE_CHECK_INTERVAL_MS)
+        {
+            close_idle_connections(worker);
+            last_sweep = now;
+        }
+    }
+
+    close_all_connections(worker);
+    close(worker->epfd);
+    return 0;
+}
@@ -0,0 +1,375 @@
+#define _GNU_SOURCE
+
+#include "handler.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include "../http/http.h"
+#include "../logger/logger.h"
+#include "../metrics/metrics.h"
+#include "../utils/file/file_cache.h"
+#include "../utils/string/string.h"
+#include "worker.h"
+
+static bool should_keep_alive(const struct config *config,
+                              const struct connection *connection,
+                              const struct request_header *req_header)
+{
+    // Framing of a malformed request cannot be trusted
+    if (req_header->status == BAD_REQUEST
+        || req_header->status == UNSUPPORTED_VERSION)
+        return false;
+
+    // Unread body would be parsed as the next request
+    if (req_header->has_body)
+        return false;
+
+    if (config->max_requests && connection->requests >= config->max_requests)
+        return false;
+
+    return req_header->keep_alive && config->keep_alive_timeout
+        && !shutting_down();
+}
+
+static enum request_status open_target(struct file_cache *files,
+                                       const struct request_header *req_header,
+                                       struct cached_file **file)
+{
+    *file = file_cache_open(files, req_header->filename);
+    if (*file)
+        return OK;
+
+    if (errno == ENOENT || errno == ENOTDIR || errno == EISDIR
+        || errno == ENAMETOOLONG)
+        return NOT_FOUND;
+    return FORBIDDEN;
+}
+
+static uint64_t monotonic_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static void log_access(const struct config *config,
+                       const struct connection *connection,
+                       const struct header_parts *header,
+                       off_t body_length)
+{
+    if (!config->access_log)
+        return;
+
+    struct access_stats stats = {
+        .bytes = header->size + body_length,
+        .latency = monotonic_us() - connection->received_at,
+    };
+    logger_access(config, &connection->parsed, &connection->sender, &stats);
+}
+
+static struct response_header *build_response(struct worker *worker,
+                                              struct connection *connection,
+                                              struct response_body *body)
+{
+    struct request_header *req_header = &connection->parsed;
+    req_header->keep_alive =
+        should_keep_alive(worker->config, connection, req_header);
+
+    // Response lives in the connection's arena until it is sent, the
+    // validators are copied there
+    struct response_header *response = create_response(
+        req_header, body->length, &worker->date, &connection->arena);
+    if (!response || !body->file)
+        return response;
+
+    response->etag = body->file->etag;
+    response->last_modified = body->file->last_modified;
+    response->accept_ranges = true;
+    response->ranges = body->ranges;
+    response->range_count = body->range_count;
+    response->file_size = body->file->size;
+    response->content_encoding = body->encoding;
+    response->vary_encoding = body->vary;
+    if (body->range_count > 1)
+        body->length = response->content_length = multipart_length(response);
+    return response;
+}
+
+// Queue the header, then each range of the file after its delimiter. Every
+// part holds its own reference to the file
+static bool queue_multipart(struct connection *connection,
+                            struct header_parts *header,
+                            const struct response_header *response,
+                            const struct response_body *body)
+{
+    struct response_body part = { 0 };
+    if (!queue_response(connection, header, &part))
+        return false;
+
+    for (size_t i = 0; i <= response->range_count; i++)
+    {
+        part.part = true;
+        part.file = NULL;
+        part.length = 0;
+        if (i < response->range_count)
+        {
+            part.file = file_cache_retain(body->file);
+            part.offset = response->ranges[i].start;
+            part.length = response->ranges[i].length;
+        }
+
+        struct header_parts *delimiter =
+            multipart_header(response, i, &connection->arena);
+        if (!delimiter || !queue_response(connection, delimiter, &part))
+        {
+            file_cache_release(part.file);
+            return false;
+        }
+    }
+
+    file_cache_release(body->file);
+    return true;
+}
+
+static bool queue_body(struct connection *connection,
+                       struct header_parts *header,
+                       const struct response_header *response,
+                       struct response_body *body)
+{
+    const struct request_header *req_header = &connection->parsed;
+
+    // HEAD, 304 and 416 only need the header
+    if (req_header->method != GET || req_header->status == NOT_MODIFIED
+        || req_header->status == RANGE_NOT_SATISFIABLE)
+    {
+        file_cache_release(body->file);
+        body->file = NULL;
+        body->data = NULL;
+    }
+
+    if (!header)
+        return false;
+    if (body->file && response->range_count > 1)
+        return queue_multipart(connection, header, response, body);
+    return queue_response(connection, header, body);
+}
+
+static void respond(struct worker *worker, struct connection *connection,
+                    struct response_body *body)
+{
+    const struct config *config = worker->config;
+    struct request_header *req_header = &connection->parsed;
+    struct response_header *response =
+        build_response(worker, connection, body);
+    struct header_parts *header = response
+        ? response_header_to_parts(response, &connection->arena)
+        : NULL;
+    logger_response(config, req_header, &connection->sender);
+
+    // Queue answer to client's request, the connection now owns the file
+    // reference. Out of memory, close once the queued responses are sent
+    if (!queue_body(connection, header, response, body))
+    {
+        file_cache_release(body->file);
+        connection->closing = true;
+        return;
+    }
+
+    off_t body_sent = body->file || body->data ? body->length : 0;
+    log_access(config, connection, header, body_sent);
+    metrics_status(worker->metrics, req_header->status);
+    metrics_count(worker->metrics, COUNTER_BYTES, header->size + body_sent);
+    connection->closing = !req_header->keep_alive;
+}
+
+// Open the precompressed sibling of file in coding
+static struct cached_file *open_sidecar(struct file_cache *files,
+                                        const struct cached_file *file,
+                                        enum content_coding coding)
+{
+    char path[PATH_MAX];
+    size_t size = strlen(file->path);
+    size_t suffix_size = strlen(coding_suffixes[coding]);
+    if (size + suffix_size >= PATH_MAX)
+        return NULL;
+    memcpy(path, file->path, size);
+    memcpy(path + size, coding_suffixes[coding], suffix_size + 1);
+    return file_cache_open(files, path);
+}
+
+// Swap the file for a version in the coding the client prefers, its
+// precompressed sibling or one compressed on the fly. The file is sent as is
+// while it is being compressed
+static void select_encoding(struct worker *worker,
+                            const struct request_header *req_header,
+                            struct response_body *body)
+{
+    if (!body->file)
+        return;
+    unsigned sidecars = body->file->sidecars;
+    unsigned available = worker->compressed
+        ? sidecars | compress_cache_codings(worker->compressed, body->file)
+        : sidecars;
+    if (!available)
+        return;
+
+    body->vary = true;
+    enum content_coding coding = negotiate_coding(req_header, available);
+    if (coding == CODING_IDENTITY)
+        return;
+
+    struct cached_file *encoded = sidecars & (1u << coding)
+        ? open_sidecar(worker->files, body->file, coding)
+        : compress_cache_get(worker->compressed, body->file, coding);
+    if (!encoded)
+        return;
+    file_cache_release(body->file);
+    body->file = encoded;
+    body->encoding = coding_names[coding];
+}
+
+// Narrow a GET of a file down to the ranges it asks for, Range fields that
+// are invalid or do not apply are ignored
+static void select_ranges(struct connection *connection,
+                          struct response_body *body)
+{
+    struct request_header *req_header = &connection->parsed;
+    const struct string *range = get_request_field(req_header, FIELD_RANGE);
+    if (!range || !body->file || req_header->method != GET
+        || req_header->status != OK
+        || !range_applies(req_header, body->file->etag,
+                          body->file->mtime.tv_sec))
+        return;
+
+    struct byte_range *ranges = arena_alloc(
+        &connection->arena, RANGES_MAX * sizeof(struct byte_range));
+    int count = ranges ? parse_ranges(range, body->file->size, ranges) : 0;
+    if (count < 0)
+    {
+        req_header->status = RANGE_NOT_SATISFIABLE;
+        body->length = 0;
+    }
+    else if (count > 0)
+    {
+        req_header->status = PARTIAL_CONTENT;
+        body->ranges = ranges;
+        body->range_count = count;
+        body->offset = ranges[0].start;
+        body->length = ranges[0].length;
+    }
+}
+
+static bool is_metrics_target(const struct config *config,
+                              const struct request_header *req_header)
+{
+    const char *path = config->metrics_path;
+    return path && strlen(path) == req_header->target.size
+        && !memcmp(path, req_header->target.data, req_header->target.size);
+}
+
+// Render the metrics once for the responses queued together, pipelined
+// requests would take METRICS_BODY_MAX bytes each otherwise
+static bool render_metrics(struct connection *connection)
+{
+    if (connection->metrics_body.data)
+        return true;
+
+    char *text = arena_alloc(&connection->arena, METRICS_BODY_MAX);
+    if (!text)
+        return false;
+
+    connection->metrics_body.size = metrics_render(text, METRICS_BODY_MAX);
+    connection->metrics_body.data = text;
+    return true;
+}
+
+static void handle_request(struct worker *worker,
+                           struct connection *connection,
+                           struct string *request, uint64_t parse_start)
+{
+    const struct config *config = worker->config;
+    struct request_header *req_header = &connection->parsed;
+    http_parser_finish(&connection->parser, request, config, req_header);
+    metrics_observe(worker->metrics, PHASE_PARSE, parse_start);
+    logger_request(config, req_header, &connection->sender);
+    connection->requests++;
+
+    struct response_body body = { 0 };
+    if (req_header->status == OK && is_metrics_target(config, req_header))
+    {
+        if (!render_metrics(connection))
+        {
+            connection->closing = true;
+            return;
+        }
+        body.length = connection->metrics_body.size;
+        body.data = connection->metrics_body.data;
+    }
+    // Hot files are served from the worker's cache without touching the
+    // file system
+    else if (req_header->status == OK)
+    {
+        uint64_t start = metrics_start(worker->metrics);
+        req_header->status =
+            open_target(worker->files, req_header, &body.file);
+        select_encoding(worker, req_header, &body);
+        metrics_observe(worker->metrics, PHASE_OPEN, start);
+        body.length = body.file ? body.file->size : 0;
+        if (body.file
+            && request_not_modified(req_header, body.file->etag,
+                                    body.file->mtime.tv_sec))
+            req_header->status = NOT_MODIFIED;
+        select_ranges(connection, &body);
+    }
+
+    respond(worker, connection, &body);
+}
+
+bool process_requests(struct worker *worker, struct connection *connection)
+{
+    struct string *buffer = connection->request;
+    size_t start = 0;
+
+    // Requests after the first one were at most received with this read
+    uint64_t now = monotonic_us();
+    if (!connection->received_at)
+        connection->received_at = now;
+
+    // Handle every complete request received, in order. The parser resumes
+    // where the previous read left it, invalid requests are answered as soon
+    // as they are detected. Responses are sent MAX_BATCH at a time, queuing
+    // more would only hold their memory longer
+    while (!connection->closing && connection->queued < MAX_BATCH)
+    {
+        struct string request = { .size = buffer->size - start,
+                                  .data = buffer->data + start };
+        uint64_t parse_start = metrics_start(worker->metrics);
+        if (http_parser_feed(&connection->parser, &request) == PARSE_NEED_MORE)
+            break;
+
+        request.size = connection->parser.position;
+        handle_request(worker, connection, &request, parse_start);
+        // Bytes after a request declaring a body are its unread body, not
+        // requests
+        if (connection->parsed.has_body)
+            connection->closing = true;
+        http_parser_init(&connection->parser);
+        connection->received_at = now;
+        start += request.size;
+    }
+
+    // Keep incomplete request for next read, drop anything after a closing
+    // request
+    if (connection->closing)
+        string_reset(buffer);
+    else if (start)
+    {
+        memmove(buffer->data, buffer->data + start, buffer->size - start);
+        buffer->size -= start;
+    }
+    if (!buffer->size)
+        connection->received_at = 0;
+    return buffer->size && connection->queued >= MAX_BATCH;
+}
@@ -0,0 +1,21 @@
+#ifndef HANDLER_H
+#define HANDLER_H
+
+#include "connection.h"
+#include "worker.h"
+
+/*
+** @brief Answer the complete requests received on the connection, in order.
+**        Responses are queued on the connection and incomplete requests are
+**        kept in its buffer until more data is received. Queuing stops at
+**        MAX_BATCH responses, the requests left are kept in the buffer too
+**
+** @param worker Worker owning the connection
+** @param connection
+**
+** @return true if requests may be left, to be answered once the queued
+**         responses are sent
+*/
+bool process_requests(struct worker *worker, struct connection *connection);
+
+#endif /* ! HANDLER_H */
@@ -2,37 +2,48 @@
 
 #include "server.h"
 
-#include <arpa/inet.h>
 #include <errno.h>
-#include <fcntl.h>
 #include <netdb.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/epoll.h>
-#include <sys/sendfile.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
-#include <sys/types.h>
 #include <unistd.h>
 
+#include "../compress/compressor.h"
 #include "../config/config.h"
 #include "../http/http.h"
 #include "../logger/logger.h"
-#include "../utils/file/file.h"
-#include "../utils/string/string.h"
-
-#define MAX_EVENTS 1024
+#include "../metrics/metrics.h"
+#include "../utils/file/file_cache.h"
+#include "connection.h"
+#include "worker.h"
 
 static struct config *g_config = NULL;
 static volatile sig_atomic_t shutdown_needed = false;
 
-struct connection
+// Registered in every worker's epoll instance to wake them all on shutdown
+static int wakeup_fd = -1;
+
+bool shutting_down(void)
+{
+    // Set from a signal handler and read by every worker thread
+    return __atomic_load_n(&shutdown_needed, __ATOMIC_RELAXED);
+}
+
+void request_shutdown(void)
 {
-    int fd;
-    struct string *sender;
-    struct string *request;
-};
+    uint64_t one = 1;
+    __atomic_store_n(&shutdown_needed, true, __ATOMIC_RELAXED);
+
+    // Only async-signal-safe calls here, this runs in the signal handler
+    if (wakeup_fd != -1 && write(wakeup_fd, &one, sizeof(one)) == -1)
+        return;
+}
 
 static void handle_signals(int sig)
 {
@@ -41,9 +52,7 @@ static void handle_signals(int sig)
     case SIGINT:
     case SIGTERM:
         // Graceful shutdown
-        logger_log(g_config,
-                   "-- Received termination signal, shutting down...");
-        shutdown_needed = true;
+        request_shutdown();
         break;
     default:
         // Unsupported signal
@@ -72,18 +81,6 @@ static struct addrinfo *get_ai(const struct server_config *config)
     return result;
 }
 
-static int set_nonblocking(int fd)
-{
-    // Get current flags
-    int flags = fcntl(fd, F_GETFL, 0);
-
-    if (flags == -1)
-        return -1;
-
-    // Add non blocking flag
-    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
-}
-
 static int create_socket(struct addrinfo *addr)
 {
     if (!addr)
@@ -102,10 +99,14 @@ static int create_socket(struct addrinfo *addr)
         int opt = 1;
         // Reuse address when creating socket
         if (setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(int)) == -1)
-        {
-            freeaddrinfo(addr);
             logger_error(g_config, "setsockopt()", strerror(errno));
-        }
+
+        // Let every worker bind its own socket, the kernel balances incoming
+        // connections between them
+        if (g_config->workers > 1
+            && setsockopt(sfd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(int))
+                == -1)
+            logger_error(g_config, "setsockopt()", strerror(errno));
 
         // Bind socket to address
         e = bind(sfd, p->ai_addr, p->ai_addrlen);
@@ -123,7 +124,7 @@ static int create_socket(struct addrinfo *addr)
     {
         logger_log(g_config, "-- Could not bind a socket");
         return -1;
-    };
+    }
 
     return sfd;
 }
@@ -142,6 +143,13 @@ int start_server(struct config *config)
         return -1;
     }
 
+    wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeup_fd == -1)
+    {
+        logger_error(config, "eventfd()", strerror(errno));
+        return -1;
+    }
+
     // Handle SIGINT and SIGTERM for graceful shutdown
     sa.sa_handler = handle_signals;
     if (sigaction(SIGINT, &sa, NULL) == -1
@@ -159,333 +167,174 @@ int start_server(struct config *config)
 void stop_server(int server_fd, struct config *config)
 {
     close(server_fd);
+    close(wakeup_fd);
+    wakeup_fd = -1;
     logger_destroy();
+    metrics_destroy();
     config_destroy(config);
 }
 
-static void send_data(const struct config *config, int cfd, int fd,
-                      struct response_header *response)
+void track_connection(struct worker *worker, struct connection *connection)
 {
-    struct string *response_str = response_header_to_string(response);
-
-    size_t total_sent = 0;
-
-    // Send response header
-    while (total_sent < response_str->size)
-    {
-        ssize_t sent = send(cfd, response_str->data + total_sent,
-                            response_str->size - total_sent, MSG_NOSIGNAL);
-        if (sent == -1)
-        {
-            logger_error(config, "send()", strerror(errno));
-            break;
-        }
-
-        total_sent += sent;
-    }
-
-    // Send file content if needed
-    if (fd != -1)
-    {
-        off_t file_sent = 0;
-        // Send file content
-        while (file_sent < response->content_length)
-        {
-            ssize_t sent =
-                sendfile(cfd, fd, NULL, response->content_length - file_sent);
-
-            if (sent == -1)
-            {
-                // Ressource is temporarily unavailable, try again
-                if (errno == EAGAIN || errno == EWOULDBLOCK)
-                    continue; //! This is a very unoptimized way of doing and
-                              //! should be changed to use epoll to wait for
-                              //! availability again
-
-                logger_error(config, "sendfile()", strerror(errno));
-                break;
-            }
-
-            file_sent += sent;
-        }
-    }
-
-    string_destroy(response_str);
+    // Insert connection at the head of the open connections list
+    connection->next = worker->connections;
+    if (worker->connections)
+        worker->connections->prev = connection;
+    worker->connections = connection;
 }
 
-static void handle_request(const struct config *config, struct string *request,
-                           struct string *sender, int cfd)
+void untrack_connection(struct worker *worker, struct connection *connection)
 {
-    struct request_header *req_header = parse_request(request, config);
-    logger_request(config, req_header, sender);
-
-    // Get full file path from server root_directory
-    off_t content_length = 0;
-
-    int fd = -1;
-    if (req_header->status == OK)
-    {
-        content_length = get_file_length(req_header->filename->data);
-        if (content_length == -1)
-        {
-            req_header->status = NOT_FOUND;
-            content_length = 0;
-        }
-        else if (req_header->method == GET)
-        {
-            fd = open(req_header->filename->data, O_RDONLY);
-            if (fd == -1)
-            {
-                req_header->status = FORBIDDEN;
-                content_length = 0;
-            }
-        }
-    }
-
-    struct response_header *response =
-        create_response(req_header, content_length);
-    logger_response(config, req_header, sender);
-
-    // Answer client's request
-    send_data(config, cfd, fd, response);
-
-    // Clean up
-    destroy_request(req_header);
-    destroy_response(response);
-    if (fd != -1)
-        close(fd);
+    // Unlink connection from the open connections list
+    if (connection->prev)
+        connection->prev->next = connection->next;
+    else
+        worker->connections = connection->next;
+    if (connection->next)
+        connection->next->prev = connection->prev;
 }
 
-static struct connection *create_connection(int fd, struct string *sender)
+static void log_cache_stats(const struct worker *worker)
 {
-    struct connection *connection = calloc(1, sizeof(struct connection));
+    const struct file_cache_stats *stats = &worker->files->stats;
+    char msg[256];
 
-    if (!connection)
-        return NULL;
+    sprintf(msg,
+            "-- File cache: %lu hits, %lu misses, %lu evictions, %lu memory "
+            "evictions",
+            stats->hits, stats->misses, stats->evictions,
+            stats->memory_evictions);
+    logger_log(worker->config, msg);
 
-    connection->fd = fd;
-    connection->sender = sender;
-    connection->request = string_create("", 0);
-    return connection;
+    if (!worker->compressed)
+        return;
+    const struct compress_cache_stats *compressed = &worker->compressed->stats;
+    sprintf(msg, "-- Compressed cache: %lu hits, %lu misses, %lu evictions",
+            compressed->hits, compressed->misses, compressed->evictions);
+    logger_log(worker->config, msg);
 }
 
-static void free_connection(struct connection *connection)
+static void *run_worker(void *arg)
 {
-    if (!connection)
-        return;
-
-    string_destroy(connection->sender);
-    string_destroy(connection->request);
-
-    if (connection->fd != -1)
-        close(connection->fd);
+    struct worker *worker = arg;
+
+    // Each worker owns its cache and connections, none are shared between
+    // threads
+    worker->files = file_cache_create(worker->config->file_cache,
+                                      worker->config->file_cache_memory,
+                                      worker->config->file_cache_max_body);
+    if (worker->files && worker->config->precompressed)
+        worker->files->sidecar_suffixes = coding_suffixes;
+    // Served uncompressed if it cannot be allocated
+    if (worker->config->compress_cache)
+        worker->compressed =
+            compress_cache_create(worker->config->compress_cache);
+    worker->pool = connection_pool_create(worker->config->max_connections);
+    bool ready = worker->files && worker->pool;
+    if (worker->pool)
+        worker->pool->metrics = worker->metrics;
+    int status = ready ? -1 : 0;
+    if (ready && worker->config->event_engine == IO_URING_ENGINE)
+    {
+        status = run_uring_worker(worker);
+        if (status == -1)
+            logger_log(worker->config,
+                       "-- io_uring unavailable, falling back to epoll");
+    }
 
-    free(connection);
+    if (!ready || (status == -1 && run_epoll_worker(worker) == -1))
+        logger_log(worker->config, "-- Could not start worker");
+    else
+        log_cache_stats(worker);
+    file_cache_destroy(worker->files);
+    compress_cache_destroy(worker->compressed);
+    connection_pool_destroy(worker->pool);
+
+    // Make the other workers stop as well if this one failed
+    request_shutdown();
+    return NULL;
 }
 
-static int receive_client_data(const struct config *config,
-                               struct connection *connection)
+static bool start_worker(struct worker *worker, struct config *config,
+                         int sfd)
 {
-    ssize_t n;
-    char buf[1024];
+    worker->config = config;
+    worker->sfd = sfd;
+    worker->wakeup_fd = wakeup_fd;
 
-    while (!shutdown_needed)
+    // Start listening
+    if (listen(sfd, SOMAXCONN))
     {
-        n = recv(connection->fd, buf, sizeof(buf) - 1, 0);
-
-        // Data received
-        if (n > 0)
-        {
-            string_concat_str(connection->request, buf, n);
-
-            // Header fully received
-            if (memmem(connection->request->data, connection->request->size,
-                       "\r\n\r\n", 4))
-                return 1;
-
-            continue;
-        }
-
-        // No data to receive from client anymore
-        if (n == 0)
-            return -1;
-
-        if (n == -1)
-        {
-            // Error
-            if (errno == EAGAIN || errno == EWOULDBLOCK)
-                return 0;
-
-            // Interrupt signal received
-            if (errno == EINTR)
-                continue;
-
-            logger_error(config, "recv()", strerror(errno));
-            return -1;
-        }
+        logger_error(config, "listen()", strerror(errno));
+        return false;
     }
 
-    return 0;
+    return true;
 }
 
-static void accept_and_register(int epfd, int sfd, struct config *config)
+static unsigned start_workers(struct worker *workers, struct config *config)
 {
-    while (!shutdown_needed)
-    {
-        struct sockaddr_in addr;
-        socklen_t addr_len = sizeof(addr);
-        int cfd = accept(sfd, &addr, &addr_len);
-        if (cfd == -1)
-        {
-            // No more incoming connections to accept
-            if (errno == EAGAIN || errno == EWOULDBLOCK)
-                break;
+    unsigned started = 1;
 
-            // Interrupted by signal
-            if (errno == EINTR)
-                continue;
+    for (; started < config->workers; started++)
+    {
+        struct worker *worker = &workers[started];
 
-            logger_error(config, "accept()", strerror(errno));
+        // Each worker listens on its own socket bound to the same address
+        int sfd = create_socket(get_ai(config->servers));
+        if (sfd == -1)
             break;
-        }
 
-        // Set connection to non blocking
-        if (set_nonblocking(cfd) == -1)
+        if (!start_worker(worker, config, sfd))
         {
-            close(cfd);
-            continue;
+            close(sfd);
+            break;
         }
 
-        // Get client IPv4 address
-        char ip_str[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &addr.sin_addr, ip_str, sizeof(ip_str));
-        struct string *sender = string_create(ip_str, strlen(ip_str) + 1);
-
-        struct connection *connection = create_connection(cfd, sender);
-        if (!connection)
+        int e = pthread_create(&worker->thread, NULL, run_worker, worker);
+        if (e)
         {
-            string_destroy(sender);
-            close(cfd);
-            continue;
-        }
-
-        struct epoll_event conn_event;
-        conn_event.events = EPOLLIN | EPOLLRDHUP;
-        conn_event.data.ptr = connection;
-
-        // Register new connection
-        if (epoll_ctl(epfd, EPOLL_CTL_ADD, cfd, &conn_event) == -1)
-        {
-            free_connection(connection);
-            continue;
+            logger_error(config, "pthread_create()", strerror(e));
+            close(sfd);
+            break;
         }
     }
+
+    return started;
 }
 
-static int setup_epoll(int sfd, struct config *config)
+int run_server(int sfd, struct config *config)
 {
-    // Start listening
-    if (listen(sfd, SOMAXCONN))
+    struct worker *workers = calloc(config->workers, sizeof(struct worker));
+    if (!workers || !start_worker(&workers[0], config, sfd))
     {
-        close(sfd);
-        logger_error(config, "listen()", strerror(errno));
-        return 1;
-    }
-
-    // Set listening socket to non blocking
-    if (set_nonblocking(sfd) == -1)
-    {
-        close(sfd);
-        logger_error(config, "set_nonblocking()", strerror(errno));
-        return 1;
-    }
-
-    // Create epoll instance
-    int epfd = epoll_create1(0);
-    if (epfd == -1)
-    {
-        logger_error(config, "epoll_create1()", strerror(errno));
-        return 1;
-    }
-
-    struct epoll_event event;
-    event.events = EPOLLIN;
-    event.data.ptr = NULL;
-
-    // Register listening socket
-    if (epoll_ctl(epfd, EPOLL_CTL_ADD, sfd, &event) == -1)
-    {
-        logger_error(config, "epoll_ctl ADD listen", strerror(errno));
-        close(epfd);
+        free(workers);
+        stop_server(sfd, config);
         return 1;
     }
 
-    return epfd;
-}
-
-static void close_connection(int epfd, struct connection *connection)
-{
-    epoll_ctl(epfd, EPOLL_CTL_DEL, connection->fd, NULL);
-    free_connection(connection);
-}
+    // Served on the metrics path, the server runs without them if they
+    // cannot be allocated
+    if (config->metrics_path && !metrics_init(config->workers))
+        logger_log(config, "-- Could not allocate metrics");
+    for (unsigned i = 0; i < config->workers; i++)
+        workers[i].metrics = metrics_of(i);
+    if (config->compress_cache && !compress_init(config))
+        logger_log(config, "-- Could not start compressing threads");
 
-int run_server(int sfd, struct config *config)
-{
-    int epfd = setup_epoll(sfd, config);
-    if (epfd == -1)
-        return 1;
+    // Run first worker on the calling thread, the others on their own
+    unsigned started = start_workers(workers, config);
+    run_worker(&workers[0]);
 
-    struct epoll_event events[MAX_EVENTS];
-    while (!shutdown_needed)
+    for (unsigned i = 1; i < started; i++)
     {
-        int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
-        if (n == -1)
-        {
-            // If interrupted by a signal, go to next iteration
-            if (errno == EINTR)
-                continue;
-
-            logger_error(config, "epoll_wait()", strerror(errno));
-            break;
-        }
-
-        for (int i = 0; i < n; ++i)
-        {
-            struct epoll_event *event = &events[i];
-
-            // Register incoming connection
-            if (event->data.ptr == NULL)
-            {
-                accept_and_register(epfd, sfd, config);
-                continue;
-            }
-
-            struct connection *connection = event->data.ptr;
-            // Error occured in event
-            if (event->events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP))
-            {
-                close_connection(epfd, connection);
-                continue;
-            }
-
-            // Process received data
-            if (event->events & EPOLLIN)
-            {
-                int received = receive_client_data(config, connection);
-                if (received == 1)
-                {
-                    // Full request received
-                    handle_request(config, connection->request,
-                                   connection->sender, connection->fd);
-
-                    // Close connection after handling request
-                    close_connection(epfd, connection);
-                }
-            }
-        }
+        pthread_join(workers[i].thread, NULL);
+        close(workers[i].sfd);
     }
 
-    close(epfd);
+    compress_destroy();
+    logger_log(config, "-- Shutting down server...");
+    free(workers);
     stop_server(sfd, config);
     return 0;
 }
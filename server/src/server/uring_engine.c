@@ -0,0 +1,753 @@
+#define _GNU_SOURCE
+
+#include "worker.h"
+
+#ifdef NO_IO_URING
+
+int run_uring_worker(struct worker *worker)
+{
+    (void)worker;
+    return -1;
+}
+
+#else /* ! NO_IO_URING */
+
+#    include <arpa/inet.h>
+#    include <errno.h>
+#    include <fcntl.h>
+#    include <linux/io_uring.h>
+#    include <netinet/in.h>
+#    include <poll.h>
+#    include <stdint.h>
+#    include <stdlib.h>
+#    include <string.h>
+#    include <sys/mman.h>
+#    include <sys/socket.h>
+#    include <sys/syscall.h>
+#    include <time.h>
+#    include <unistd.h>
+
+#    include "../config/config.h"
+#    include "../logger/logger.h"
+#    include "../utils/string/string.h"
+#    include "connection.h"
+#    include "handler.h"
+
+#    define RING_ENTRIES 1024
+#    define RECV_BUFFER_SIZE 4096
+#    define FIXED_BUFFERS 256
+#    define SPLICE_CHUNK 65536
+
+// Operation encoded in the low bits of a completion's user_data, the other
+// bits hold the connection, if any
+enum uring_op
+{
+    OP_ACCEPT = 0,
+    OP_WAKEUP,
+    OP_TIMEOUT,
+    OP_RECV,
+    OP_SEND,
+    OP_SPLICE_IN,
+    OP_SPLICE_OUT
+};
+#    define OP_MASK 7
+
+/*
+** @brief Submission and completion queues shared with the kernel
+**
+** @param fd io_uring instance
+** @param sqe_tail Tail of the submission queue including unsubmitted entries
+** @param buffers Receive buffers registered in the kernel
+** @param free_buffers Indexes of the registered buffers not in use
+** @param multishot_accept One accept request keeps accepting connections
+** @param tick Interval of the idle connections check
+*/
+struct ring
+{
+    int fd;
+
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sqe_tail;
+    struct io_uring_sqe *sqes;
+
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_map;
+    size_t sq_map_size;
+    void *cq_map;
+    size_t cq_map_size;
+    size_t sqes_size;
+
+    char *buffers;
+    int free_buffers[FIXED_BUFFERS];
+    unsigned free_count;
+
+    bool multishot_accept;
+    struct __kernel_timespec tick;
+};
+
+/*
+** @brief Per connection state of the io_uring engine
+**
+** @param buffer Registered buffer receiving data, -1 if none is in use
+** @param heap_buffer Receive buffer used when no registered buffer is free
+** @param pipe Pipe used to splice file bodies to the socket
+** @param piped Number of body bytes in the pipe, not sent yet
+** @param inflight Number of submitted requests not completed yet
+** @param closed The connection is freed once inflight reaches 0
+** @param iov Headers being sent
+** @param msg Message being sent
+*/
+struct uring_connection
+{
+    int buffer;
+    char *heap_buffer;
+    int pipe[2];
+    size_t piped;
+    unsigned inflight;
+    bool closed;
+    struct iovec iov[MAX_BATCH];
+    struct msghdr msg;
+};
+
+struct uring_loop
+{
+    struct worker *worker;
+    struct ring ring;
+};
+
+static int ring_map(struct ring *ring, const struct io_uring_params *params)
+{
+    ring->sq_map_size =
+        params->sq_off.array + params->sq_entries * sizeof(unsigned);
+    ring->cq_map_size = params->cq_off.cqes
+        + params->cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+
+    int prot = PROT_READ | PROT_WRITE;
+    int flags = MAP_SHARED | MAP_POPULATE;
+    ring->sq_map = mmap(NULL, ring->sq_map_size, prot, flags, ring->fd,
+                        IORING_OFF_SQ_RING);
+    ring->cq_map = mmap(NULL, ring->cq_map_size, prot, flags, ring->fd,
+                        IORING_OFF_CQ_RING);
+    ring->sqes =
+        mmap(NULL, ring->sqes_size, prot, flags, ring->fd, IORING_OFF_SQES);
+    if (ring->sq_map == MAP_FAILED || ring->cq_map == MAP_FAILED
+        || ring->sqes == MAP_FAILED)
+        return -1;
+
+    char *sq = ring->sq_map;
+    ring->sq_head = (unsigned *)(sq + params->sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params->sq_off.tail);
+    ring->sq_array = (unsigned *)(sq + params->sq_off.array);
+    ring->sq_mask = *(unsigned *)(sq + params->sq_off.ring_mask);
+    ring->sq_entries = params->sq_entries;
+    ring->sqe_tail = *ring->sq_tail;
+
+    char *cq = ring->cq_map;
+    ring->cq_head = (unsigned *)(cq + params->cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params->cq_off.tail);
+    ring->cq_mask = *(unsigned *)(cq + params->cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params->cq_off.cqes);
+    return 0;
+}
+
+static bool ring_supports(int fd)
+{
+    static const int required[] = { IORING_OP_ACCEPT,   IORING_OP_READ_FIXED,
+                                    IORING_OP_RECV,     IORING_OP_SENDMSG,
+                                    IORING_OP_SPLICE,   IORING_OP_POLL_ADD,
+                                    IORING_OP_TIMEOUT };
+    size_t size = sizeof(struct io_uring_probe)
+        + IORING_OP_LAST * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+    if (!probe)
+        return false;
+
+    bool supported = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE,
+                             probe, IORING_OP_LAST)
+        != -1;
+    for (size_t i = 0; supported && i < sizeof(required) / sizeof(int); i++)
+    {
+        int op = required[i];
+        supported = op <= probe->last_op
+            && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    free(probe);
+    return supported;
+}
+
+static void register_buffers(struct ring *ring)
+{
+    size_t size = (size_t)FIXED_BUFFERS * RECV_BUFFER_SIZE;
+    ring->buffers = malloc(size);
+    if (!ring->buffers)
+        return;
+
+    // A single region holds every buffer, reads target a slot inside it
+    struct iovec iov = { .iov_base = ring->buffers, .iov_len = size };
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS,
+                &iov, 1)
+        == -1)
+    {
+        // Locked memory limit reached, receive in heap buffers instead
+        free(ring->buffers);
+        ring->buffers = NULL;
+        return;
+    }
+
+    for (int i = 0; i < FIXED_BUFFERS; i++)
+        ring->free_buffers[ring->free_count++] = i;
+}
+
+static void ring_destroy(struct ring *ring)
+{
+    if (ring->sq_map && ring->sq_map != MAP_FAILED)
+        munmap(ring->sq_map, ring->sq_map_size);
+    if (ring->cq_map && ring->cq_map != MAP_FAILED)
+        munmap(ring->cq_map, ring->cq_map_size);
+    if (ring->sqes && ring->sqes != MAP_FAILED)
+        munmap(ring->sqes, ring->sqes_size);
+
+    close(ring->fd);
+    free(ring->buffers);
+}
+
+static int ring_setup(struct ring *ring)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    ring->fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+    if (ring->fd == -1)
+        return -1;
+
+    // Completions must never be dropped and sockets must be polled
+    // internally instead of blocking a kernel thread
+    unsigned features = IORING_FEAT_NODROP | IORING_FEAT_FAST_POLL;
+    if ((params.features & features) != features || !ring_supports(ring->fd)
+        || ring_map(ring, &params) == -1)
+    {
+        ring_destroy(ring);
+        return -1;
+    }
+
+    register_buffers(ring);
+    ring->multishot_accept = true;
+    ring->tick.tv_sec = 1;
+    return 0;
+}
+
+static int ring_submit(struct ring *ring, unsigned wait)
+{
+    __atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+    unsigned to_submit =
+        ring->sqe_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+    return syscall(__NR_io_uring_enter, ring->fd, to_submit, wait,
+                   wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+static struct io_uring_sqe *get_sqe(struct ring *ring, uint64_t user_data)
+{
+    // Submission queue full, hand queued entries to the kernel first
+    if (ring->sqe_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE)
+        >= ring->sq_entries)
+        ring_submit(ring, 0);
+
+    unsigned index = ring->sqe_tail & ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->user_data = user_data;
+
+    ring->sq_array[index] = index;
+    ring->sqe_tail++;
+    return sqe;
+}
+
+static uint64_t tag(struct connection *connection, enum uring_op op)
+{
+    return (uintptr_t)connection | op;
+}
+
+static void arm_accept(struct uring_loop *loop)
+{
+    struct io_uring_sqe *sqe = get_sqe(&loop->ring, tag(NULL, OP_ACCEPT));
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = loop->worker->sfd;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    if (loop->ring.multishot_accept)
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+}
+
+static void arm_wakeup(struct uring_loop *loop)
+{
+    // Poll does not consume the event, every worker gets woken up
+    struct io_uring_sqe *sqe = get_sqe(&loop->ring, tag(NULL, OP_WAKEUP));
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = loop->worker->wakeup_fd;
+    sqe->poll32_events = POLLIN;
+}
+
+static void arm_timeout(struct uring_loop *loop)
+{
+    struct io_uring_sqe *sqe = get_sqe(&loop->ring, tag(NULL, OP_TIMEOUT));
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->addr = (uintptr_t)&loop->ring.tick;
+    sqe->len = 1;
+}
+
+// Return false if no receive buffer could be allocated
+static bool arm_recv(struct uring_loop *loop, struct connection *connection)
+{
+    struct ring *ring = &loop->ring;
+    struct uring_connection *uring = connection->uring;
+
+    // Read straight into a registered buffer when one is free
+    if (uring->buffer == -1 && ring->free_count)
+        uring->buffer = ring->free_buffers[--ring->free_count];
+    if (uring->buffer == -1 && !uring->heap_buffer)
+    {
+        uring->heap_buffer = malloc(RECV_BUFFER_SIZE);
+        if (!uring->heap_buffer)
+        {
+            logger_error(loop->worker->config, "recv()", strerror(ENOMEM));
+            return false;
+        }
+    }
+
+    struct io_uring_sqe *sqe = get_sqe(ring, tag(connection, OP_RECV));
+    sqe->fd = connection->fd;
+    sqe->len = RECV_BUFFER_SIZE;
+    uring->inflight++;
+    if (uring->buffer != -1)
+    {
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->addr =
+            (uintptr_t)(ring->buffers + uring->buffer * RECV_BUFFER_SIZE);
+        sqe->buf_index = 0;
+    }
+    else
+    {
+        sqe->opcode = IORING_OP_RECV;
+        sqe->addr = (uintptr_t)uring->heap_buffer;
+    }
+    return true;
+}
+
+static void arm_splice(struct uring_loop *loop, struct connection *connection,
+                       const struct pending_response *response)
+{
+    struct uring_connection *uring = connection->uring;
+    size_t length = uring->piped;
+    off_t left = response->remaining;
+
+    // Pipe empty, fill it from the file and link the send to the socket
+    if (!length)
+    {
+        length = left < SPLICE_CHUNK ? left : SPLICE_CHUNK;
+        left -= length;
+
+        struct io_uring_sqe *in =
+            get_sqe(&loop->ring, tag(connection, OP_SPLICE_IN));
+        in->opcode = IORING_OP_SPLICE;
+        in->fd = uring->pipe[1];
+        in->off = -1;
+        in->splice_fd_in = response->file->fd;
+        in->splice_off_in = response->offset;
+        in->len = length;
+        in->flags = IOSQE_IO_LINK;
+        uring->inflight++;
+    }
+
+    struct io_uring_sqe *out =
+        get_sqe(&loop->ring, tag(connection, OP_SPLICE_OUT));
+    out->opcode = IORING_OP_SPLICE;
+    out->fd = connection->fd;
+    out->off = -1;
+    out->splice_fd_in = uring->pipe[0];
+    out->splice_off_in = -1;
+    out->len = length;
+    uring->inflight++;
+
+    // More of the body follows, do not push a partial segment
+    if (left > 0 && loop->worker->config->tcp_nopush)
+        out->splice_flags = SPLICE_F_MORE;
+}
+
+static void arm_send(struct uring_loop *loop, struct connection *connection)
+{
+    struct uring_connection *uring = connection->uring;
+    struct pending_response *last = NULL;
+    size_t count = gather_buffers(connection, uring->iov, MAX_BATCH, &last);
+
+    struct io_uring_sqe *sqe = get_sqe(&loop->ring, tag(connection, OP_SEND));
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = connection->fd;
+    sqe->addr = (uintptr_t)&uring->msg;
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+    uring->msg.msg_iov = uring->iov;
+    uring->msg.msg_iovlen = count;
+    uring->inflight++;
+
+    // File body of the last gathered response follows its header in the
+    // same chain, the chain is cut if the buffers are not fully sent
+    if (last)
+    {
+        sqe->flags = IOSQE_IO_LINK;
+        if (loop->worker->config->tcp_nopush)
+            sqe->msg_flags |= MSG_MORE;
+        arm_splice(loop, connection, last);
+    }
+}
+
+static void destroy_connection(struct uring_loop *loop,
+                               struct connection *connection)
+{
+    struct uring_connection *uring = connection->uring;
+    struct ring *ring = &loop->ring;
+
+    if (uring->buffer != -1)
+        ring->free_buffers[ring->free_count++] = uring->buffer;
+    if (uring->pipe[0] != -1)
+    {
+        close(uring->pipe[0]);
+        close(uring->pipe[1]);
+    }
+
+    free(uring->heap_buffer);
+    free(uring);
+    untrack_connection(loop->worker, connection);
+    free_connection(loop->worker->pool, connection);
+}
+
+static void close_connection(struct uring_loop *loop,
+                             struct connection *connection)
+{
+    struct uring_connection *uring = connection->uring;
+    if (uring->closed)
+        return;
+
+    // Make pending requests complete, the connection is freed after the
+    // last one
+    (void)loop;
+    uring->closed = true;
+    shutdown(connection->fd, SHUT_RDWR);
+}
+
+static bool has_body(const struct connection *connection)
+{
+    if (connection->uring->piped)
+        return true;
+
+    for (struct pending_response *r = connection->responses; r; r = r->next)
+        if (r->remaining > 0 && !r->body)
+            return true;
+    return false;
+}
+
+static void send_next(struct uring_loop *loop, struct connection *connection)
+{
+    struct uring_connection *uring = connection->uring;
+    struct pending_response *response = connection->responses;
+
+    // Everything was sent, answer the requests left by the last batch
+    if (!response && !connection->closing && connection->request->size)
+    {
+        process_requests(loop->worker, connection);
+        response = connection->responses;
+    }
+
+    // Nothing left to answer, wait for the next requests
+    if (!response)
+    {
+        if (connection->closing || !arm_recv(loop, connection))
+            close_connection(loop, connection);
+        return;
+    }
+
+    // Bodies go through a pipe, splice needs one end of it to be a pipe
+    if (uring->pipe[0] == -1 && has_body(connection)
+        && pipe(uring->pipe) == -1)
+    {
+        logger_error(loop->worker->config, "pipe()", strerror(errno));
+        close_connection(loop, connection);
+        return;
+    }
+
+    if (response->header_sent < response->header->size || response->body)
+        arm_send(loop, connection);
+    else
+        arm_splice(loop, connection, response);
+}
+
+static void complete_recv(struct uring_loop *loop,
+                          struct connection *connection, int res)
+{
+    struct uring_connection *uring = connection->uring;
+    struct ring *ring = &loop->ring;
+
+    // Client closed the connection or an error occured
+    if (res <= 0)
+    {
+        close_connection(loop, connection);
+        return;
+    }
+
+    char *data = uring->buffer != -1
+        ? ring->buffers + uring->buffer * RECV_BUFFER_SIZE
+        : uring->heap_buffer;
+    bool stored = string_concat_str(connection->request, data, res);
+    connection->last_active = time(NULL);
+
+    // Give the registered buffer back until the next read
+    if (uring->buffer != -1)
+    {
+        ring->free_buffers[ring->free_count++] = uring->buffer;
+        uring->buffer = -1;
+    }
+    if (!stored)
+    {
+        logger_error(loop->worker->config, "recv()", strerror(ENOMEM));
+        close_connection(loop, connection);
+        return;
+    }
+
+    // Answer the complete requests a batch at a time, stop reading until
+    // they are all sent. A single read is buffered at a time, so at most an
+    // incomplete header and RECV_BUFFER_SIZE bytes are kept, well below
+    // CONNECTION_BUFFER_MAX
+    process_requests(loop->worker, connection);
+    send_next(loop, connection);
+}
+
+static void complete_send(struct connection *connection, enum uring_op op,
+                          int res)
+{
+    struct uring_connection *uring = connection->uring;
+    struct pending_response *response = connection->responses;
+
+    // Link cut by a short operation, the next step starts over from there
+    if (res <= 0 || uring->closed)
+        return;
+
+    connection->last_active = time(NULL);
+    if (op == OP_SEND)
+    {
+        account_sent_buffers(connection, res);
+        pop_sent_responses(connection);
+    }
+    else if (op == OP_SPLICE_IN)
+    {
+        uring->piped += res;
+        response->offset += res;
+        response->remaining -= res;
+    }
+    else
+    {
+        uring->piped -= res;
+        if (!uring->piped)
+            pop_sent_responses(connection);
+    }
+}
+
+static void complete_connection(struct uring_loop *loop,
+                                const struct io_uring_cqe *cqe)
+{
+    struct connection *connection =
+        (struct connection *)(uintptr_t)(cqe->user_data & ~(uint64_t)OP_MASK);
+    enum uring_op op = cqe->user_data & OP_MASK;
+    struct uring_connection *uring = connection->uring;
+
+    uring->inflight--;
+    if (op == OP_RECV)
+    {
+        if (!uring->closed)
+            complete_recv(loop, connection, cqe->res);
+    }
+    // A file that got shorter since its size was read cannot fill the
+    // Content-Length sent, the client would read what follows as its body
+    else if ((cqe->res < 0 && cqe->res != -ECANCELED)
+             || (op == OP_SPLICE_IN && cqe->res == 0))
+        close_connection(loop, connection);
+    else
+        complete_send(connection, op, cqe->res);
+
+    // Last request of a step completed, move on to the next one
+    if (!uring->inflight && !uring->closed && op != OP_RECV)
+        send_next(loop, connection);
+
+    if (!uring->inflight && uring->closed)
+        destroy_connection(loop, connection);
+}
+
+static void accept_connection(struct uring_loop *loop, int cfd)
+{
+    uint64_t start = metrics_start(loop->worker->metrics);
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    char ip_str[INET_ADDRSTRLEN] = "";
+
+    // Get client IPv4 address
+    if (getpeername(cfd, (struct sockaddr *)&addr, &addr_len) == 0)
+        inet_ntop(AF_INET, &addr.sin_addr, ip_str, sizeof(ip_str));
+
+    // Too many clients already, turn this one away
+    struct connection *connection =
+        create_connection(loop->worker->pool, cfd, ip_str);
+    struct uring_connection *uring = calloc(1, sizeof(struct uring_connection));
+    if (!connection || !uring)
+    {
+        free(uring);
+        if (connection)
+            free_connection(loop->worker->pool, connection);
+        else
+            close(cfd);
+        return;
+    }
+
+    uring->buffer = -1;
+    uring->pipe[0] = -1;
+    uring->pipe[1] = -1;
+    connection->uring = uring;
+    track_connection(loop->worker, connection);
+    if (!arm_recv(loop, connection))
+        destroy_connection(loop, connection);
+    metrics_observe(loop->worker->metrics, PHASE_ACCEPT, start);
+}
+
+static void complete_accept(struct uring_loop *loop,
+                            const struct io_uring_cqe *cqe)
+{
+    if (cqe->res >= 0)
+    {
+        if (shutting_down())
+            close(cqe->res);
+        else
+            accept_connection(loop, cqe->res);
+    }
+    // Kernel older than 5.19, accept one connection per request
+    else if (cqe->res == -EINVAL && loop->ring.multishot_accept)
+        loop->ring.multishot_accept = false;
+    else
+        logger_error(loop->worker->config, "accept()", strerror(-cqe->res));
+
+    if (!(cqe->flags & IORING_CQE_F_MORE) && !shutting_down())
+        arm_accept(loop);
+}
+
+static void close_idle_connections(struct uring_loop *loop)
+{
+    time_t now = time(NULL);
+    struct connection *connection = loop->worker->connections;
+
+    while (connection)
+    {
+        struct connection *next = connection->next;
+        if (now - connection->last_active
+            >= loop->worker->config->keep_alive_timeout)
+            close_connection(loop, connection);
+
+        connection = next;
+    }
+}
+
+static void handle_completion(struct uring_loop *loop,
+                              const struct io_uring_cqe *cqe)
+{
+    switch (cqe->user_data & OP_MASK)
+    {
+    case OP_ACCEPT:
+        complete_accept(loop, cqe);
+        break;
+    case OP_WAKEUP:
+        // Shutdown requested, loop condition ends the worker
+        break;
+    case OP_TIMEOUT:
+        close_idle_connections(loop);
+        if (!shutting_down())
+            arm_timeout(loop);
+        break;
+    default:
+        complete_connection(loop, cqe);
+        break;
+    }
+}
+
+static void reap_completions(struct uring_loop *loop)
+{
+    struct ring *ring = &loop->ring;
+    unsigned head = *ring->cq_head;
+
+    while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+    {
+        // Copy the entry and release its slot before handling it, handlers
+        // submit new requests
+        struct io_uring_cqe cqe = ring->cqes[head & ring->cq_mask];
+        __atomic_store_n(ring->cq_head, ++head, __ATOMIC_RELEASE);
+        handle_completion(loop, &cqe);
+    }
+}
+
+static void close_all_connections(struct uring_loop *loop)
+{
+    struct connection *connection = loop->worker->connections;
+    while (connection)
+    {
+        struct connection *next = connection->next;
+        close_connection(loop, connection);
+        connection = next;
+    }
+
+    // Wait for the requests still referencing the connections
+    while (loop->worker->connections)
+    {
+        if (ring_submit(&loop->ring, 1) == -1 && errno != EINTR)
+            break;
+        reap_completions(loop);
+    }
+}
+
+int run_uring_worker(struct worker *worker)
+{
+    struct uring_loop loop;
+    memset(&loop, 0, sizeof(loop));
+    loop.worker = worker;
+
+    if (ring_setup(&loop.ring) == -1)
+        return -1;
+    worker->epfd = loop.ring.fd;
+
+    arm_accept(&loop);
+    arm_wakeup(&loop);
+    if (worker->config->keep_alive_timeout)
+        arm_timeout(&loop);
+
+    while (!shutting_down())
+    {
+        // Submit queued requests and wait for at least one completion
+        if (ring_submit(&loop.ring, 1) == -1 && errno != EINTR)
+        {
+            logger_error(worker->config, "io_uring_enter()", strerror(errno));
+            break;
+        }
+
+        // Responses to the completions below share the same Date
+        http_date_update(&worker->date, time(NULL));
+        reap_completions(&loop);
+    }
+
+    close_all_connections(&loop);
+    ring_destroy(&loop.ring);
+    return 0;
+}
+
+#endif /* NO_IO_URING */
@@ -0,0 +1,57 @@
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "../compress/compress_cache.h"
+#include "../config/config.h"
+#include "../utils/file/file_cache.h"
+#include "connection.h"
+
+/*
+** @brief Event loop running on its own thread with its own listening socket
+**
+** @param thread Thread running the loop
+** @param sfd Listening socket, bound with SO_REUSEPORT
+** @param epfd Epoll instance or io_uring file descriptor
+** @param wakeup_fd Becomes readable when the server shuts down
+** @param config Server configuration
+** @param connections Open connections, used to close idle ones
+** @param pool Connections of this worker, bounding how many can be open
+** @param files Open files served by this worker
+** @param compressed Files compressed on the fly for this worker, NULL when
+**        responses are not compressed
+** @param date Date of the responses, refreshed by the event loop
+** @param metrics Counters of this worker, NULL when metrics are disabled
+*/
+struct worker
+{
+    pthread_t thread;
+    int sfd;
+    int epfd;
+    int wakeup_fd;
+    struct config *config;
+    struct connection *connections;
+    struct connection_pool *pool;
+    struct file_cache *files;
+    struct compress_cache *compressed;
+    struct http_date date;
+    struct metrics *metrics;
+};
+
+bool shutting_down(void);
+void request_shutdown(void);
+
+void track_connection(struct worker *worker, struct connection *connection);
+void untrack_connection(struct worker *worker, struct connection *connection);
+
+/*
+** @brief Run the worker's event loop until the server shuts down
+**
+** @return 0 once the server shut down, -1 if the engine could not be set up
+*/
+int run_epoll_worker(struct worker *worker);
+int run_uring_worker(struct worker *worker);
+
+#endif /* ! WORKER_H */
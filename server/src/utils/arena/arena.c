@@ -0,0 +1,101 @@
+#include "arena.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+void arena_init(struct arena *arena, size_t block_size)
+{
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->block_size = block_size;
+}
+
+static void *bump(struct arena_block *block, size_t size)
+{
+    uintptr_t address = (uintptr_t)(block->data + block->used);
+    size_t padding = (ARENA_ALIGNMENT - address % ARENA_ALIGNMENT)
+        % ARENA_ALIGNMENT;
+    if (block->size - block->used < padding + size)
+        return NULL;
+
+    void *memory = block->data + block->used + padding;
+    block->used += padding + size;
+    return memory;
+}
+
+static struct arena_block *next_block(struct arena *arena, size_t size)
+{
+    struct arena_block *current = arena->current;
+    struct arena_block *next = current ? current->next : arena->first;
+
+    // Reuse the block that followed the current one before the last reset
+    if (next && next->size >= size + ARENA_ALIGNMENT)
+    {
+        next->used = 0;
+        return next;
+    }
+
+    size_t block_size = arena->block_size > size + ARENA_ALIGNMENT
+        ? arena->block_size
+        : size + ARENA_ALIGNMENT;
+    struct arena_block *block = malloc(sizeof(struct arena_block) + block_size);
+    if (!block)
+        return NULL;
+
+    block->size = block_size;
+    block->used = 0;
+    block->next = next;
+    if (current)
+        current->next = block;
+    else
+        arena->first = block;
+    return block;
+}
+
+void *arena_alloc(struct arena *arena, size_t size)
+{
+    void *memory = arena->current ? bump(arena->current, size) : NULL;
+    if (memory)
+        return memory;
+
+    struct arena_block *block = next_block(arena, size);
+    if (!block)
+        return NULL;
+
+    arena->current = block;
+    return bump(block, size);
+}
+
+void arena_reset(struct arena *arena)
+{
+    arena->current = arena->first;
+    if (arena->first)
+        arena->first->used = 0;
+}
+
+static void free_blocks(struct arena_block *block)
+{
+    while (block)
+    {
+        struct arena_block *next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
+void arena_trim(struct arena *arena)
+{
+    arena_reset(arena);
+    if (!arena->first)
+        return;
+
+    free_blocks(arena->first->next);
+    arena->first->next = NULL;
+}
+
+void arena_destroy(struct arena *arena)
+{
+    free_blocks(arena->first);
+    arena->first = NULL;
+    arena->current = NULL;
+}
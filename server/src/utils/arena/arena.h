@@ -0,0 +1,70 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Alignment of every allocation, enough for any type the server stores
+#define ARENA_ALIGNMENT 16
+
+/*
+** @brief Block of memory allocations are carved from
+**
+** @param next Next block of the arena, reused after a reset
+** @param size Number of usable bytes in data
+** @param used Number of bytes of data already allocated
+*/
+struct arena_block
+{
+    struct arena_block *next;
+    size_t size;
+    size_t used;
+    char data[];
+};
+
+/*
+** @brief Bump allocator for objects sharing the same lifetime. Everything is
+**        freed at once by arena_reset, which keeps the blocks for the next
+**        allocations
+**
+** @param first First block, NULL until the first allocation
+** @param current Block allocations are made from
+** @param block_size Size of the blocks allocated, larger allocations get a
+**        block of their own
+*/
+struct arena
+{
+    struct arena_block *first;
+    struct arena_block *current;
+    size_t block_size;
+};
+
+/*
+** @brief Initialize an empty arena, no memory is allocated until needed
+*/
+void arena_init(struct arena *arena, size_t block_size);
+
+/*
+** @brief Allocate size bytes aligned on ARENA_ALIGNMENT, valid until the next
+**        reset
+**
+** @return the allocated memory, NULL if a block could not be allocated
+*/
+void *arena_alloc(struct arena *arena, size_t size);
+
+/*
+** @brief Free every allocation in constant time, the blocks are kept
+*/
+void arena_reset(struct arena *arena);
+
+/*
+** @brief Reset the arena and give every block but the first back to the
+**        system, so that a burst of allocations is not kept forever
+*/
+void arena_trim(struct arena *arena);
+
+/*
+** @brief Give the blocks back to the system
+*/
+void arena_destroy(struct arena *arena);
+
+#endif /* ! ARENA_H */
@@ -0,0 +1,371 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "file_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MIN_BUCKETS 16
+
+static size_t hash_path(const char *path)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *c = (const unsigned char *)path; *c; c++)
+    {
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+struct file_cache *file_cache_create(size_t capacity, size_t memory_budget,
+                                     size_t max_body)
+{
+    struct file_cache *cache = calloc(1, sizeof(struct file_cache));
+    if (!cache)
+        return NULL;
+
+    // Power of two buckets, at least one per entry
+    cache->bucket_count = MIN_BUCKETS;
+    while (cache->bucket_count < capacity)
+        cache->bucket_count *= 2;
+
+    cache->buckets = calloc(cache->bucket_count, sizeof(struct cached_file *));
+    if (!cache->buckets)
+    {
+        free(cache);
+        return NULL;
+    }
+
+    cache->capacity = capacity;
+    cache->memory_budget = memory_budget;
+    cache->max_body = max_body;
+    return cache;
+}
+
+static struct cached_file **find_slot(struct file_cache *cache,
+                                      const char *path)
+{
+    size_t index = hash_path(path) & (cache->bucket_count - 1);
+    struct cached_file **slot = &cache->buckets[index];
+
+    while (*slot && strcmp((*slot)->path, path))
+        slot = &(*slot)->hash_next;
+
+    return slot;
+}
+
+static void lru_unlink(struct file_cache *cache, struct cached_file *file)
+{
+    if (file->lru_prev)
+        file->lru_prev->lru_next = file->lru_next;
+    else
+        cache->lru_head = file->lru_next;
+
+    if (file->lru_next)
+        file->lru_next->lru_prev = file->lru_prev;
+    else
+        cache->lru_tail = file->lru_prev;
+
+    file->lru_prev = NULL;
+    file->lru_next = NULL;
+}
+
+static void lru_push_front(struct file_cache *cache, struct cached_file *file)
+{
+    file->lru_next = cache->lru_head;
+    if (cache->lru_head)
+        cache->lru_head->lru_prev = file;
+    else
+        cache->lru_tail = file;
+
+    cache->lru_head = file;
+}
+
+static void memory_unlink(struct file_cache *cache, struct cached_file *file)
+{
+    if (file->memory_prev)
+        file->memory_prev->memory_next = file->memory_next;
+    else
+        cache->memory_head = file->memory_next;
+
+    if (file->memory_next)
+        file->memory_next->memory_prev = file->memory_prev;
+    else
+        cache->memory_tail = file->memory_prev;
+
+    file->memory_prev = NULL;
+    file->memory_next = NULL;
+}
+
+static void memory_push_front(struct file_cache *cache,
+                              struct cached_file *file)
+{
+    file->memory_next = cache->memory_head;
+    if (cache->memory_head)
+        cache->memory_head->memory_prev = file;
+    else
+        cache->memory_tail = file;
+
+    cache->memory_head = file;
+}
+
+static void remove_entry(struct file_cache *cache, struct cached_file *file)
+{
+    // Entry stays open and keeps its body until the responses sending it
+    // are done
+    *find_slot(cache, file->path) = file->hash_next;
+    lru_unlink(cache, file);
+    if (file->body)
+    {
+        memory_unlink(cache, file);
+        cache->memory_used -= file->size;
+    }
+
+    file->hash_next = NULL;
+    file->cached = false;
+    cache->count--;
+    file_cache_release(file);
+}
+
+static bool has_suffix(const char *path, size_t size, const char *suffix)
+{
+    size_t suffix_size = strlen(suffix);
+    return size >= suffix_size
+        && !strcmp(path + size - suffix_size, suffix);
+}
+
+// Look for the siblings of file, unless it is a sibling itself
+static unsigned find_sidecars(const struct file_cache *cache,
+                              const struct cached_file *file)
+{
+    const char *const *suffixes = cache->sidecar_suffixes;
+    size_t size = strlen(file->path);
+    for (size_t i = 0; suffixes && suffixes[i]; i++)
+        if (has_suffix(file->path, size, suffixes[i]))
+            return 0;
+
+    char path[PATH_MAX];
+    unsigned sidecars = 0;
+    for (size_t i = 0; suffixes && suffixes[i]; i++)
+    {
+        struct stat st;
+        if (size + strlen(suffixes[i]) >= PATH_MAX)
+            continue;
+        memcpy(path, file->path, size);
+        strcpy(path + size, suffixes[i]);
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode)
+            && st.st_mtim.tv_sec >= file->mtime.tv_sec)
+            sidecars |= 1u << i;
+    }
+    return sidecars;
+}
+
+static bool is_stale(struct file_cache *cache, struct cached_file *file,
+                     time_t now)
+{
+    if (now == file->checked)
+        return false;
+
+    // Replaced, modified or removed since it was opened
+    struct stat st;
+    if (stat(file->path, &st) == -1 || st.st_ino != file->ino
+        || st.st_dev != file->dev || st.st_size != file->size
+        || st.st_mtim.tv_sec != file->mtime.tv_sec
+        || st.st_mtim.tv_nsec != file->mtime.tv_nsec)
+        return true;
+
+    // Siblings can be added or removed without touching the file
+    file->sidecars = find_sidecars(cache, file);
+    file->checked = now;
+    return false;
+}
+
+static int open_evicting(struct file_cache *cache, const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    // Out of file descriptors, give back the least recently used ones
+    while (fd == -1 && (errno == EMFILE || errno == ENFILE) && cache->lru_tail)
+    {
+        cache->stats.evictions++;
+        remove_entry(cache, cache->lru_tail);
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+    }
+
+    return fd;
+}
+
+static struct cached_file *open_file(struct file_cache *cache,
+                                     const char *path, time_t now)
+{
+    int fd = open_evicting(cache, path);
+    if (fd == -1)
+        return NULL;
+
+    // Only regular files are served
+    struct stat st;
+    int error = 0;
+    if (fstat(fd, &st) == -1)
+        error = errno;
+    else if (!S_ISREG(st.st_mode))
+        error = S_ISDIR(st.st_mode) ? EISDIR : EACCES;
+
+    struct cached_file *file =
+        error ? NULL : calloc(1, sizeof(struct cached_file));
+    if (file)
+        file->path = strdup(path);
+    if (!file || !file->path)
+    {
+        free(file);
+        close(fd);
+        errno = error ? error : ENOMEM;
+        return NULL;
+    }
+
+    file->fd = fd;
+    file->size = st.st_size;
+    file->mtime = st.st_mtim;
+    file->ino = st.st_ino;
+    file->dev = st.st_dev;
+    file->checked = now;
+    file->refs = 1;
+    snprintf(file->etag, ETAG_SIZE, "\"%jx-%jx-%jx\"", (uintmax_t)st.st_ino,
+             (uintmax_t)st.st_size, (uintmax_t)st.st_mtim.tv_sec);
+    struct tm tm_info;
+    gmtime_r(&st.st_mtim.tv_sec, &tm_info);
+    strftime(file->last_modified, LAST_MODIFIED_SIZE,
+             "%a, %d %b %Y %H:%M:%S GMT", &tm_info);
+    file->sidecars = find_sidecars(cache, file);
+    return file;
+}
+
+static void load_body(struct file_cache *cache, struct cached_file *file)
+{
+    size_t size = file->size;
+    if (!size || size > cache->max_body || size > cache->memory_budget)
+        return;
+
+    // Make room by evicting the least recently used in memory files
+    while (cache->memory_used + size > cache->memory_budget)
+    {
+        cache->stats.memory_evictions++;
+        remove_entry(cache, cache->memory_tail);
+    }
+
+    file->body = malloc(size);
+    size_t loaded = 0;
+    while (file->body && loaded < size)
+    {
+        ssize_t n = pread(file->fd, file->body + loaded, size - loaded, loaded);
+        if (n <= 0)
+        {
+            // Read error or file got shorter, serve it from the fd instead
+            free(file->body);
+            file->body = NULL;
+            return;
+        }
+        loaded += n;
+    }
+
+    if (!file->body)
+        return;
+
+    memory_push_front(cache, file);
+    cache->memory_used += size;
+}
+
+static void insert_entry(struct file_cache *cache, struct cached_file *file)
+{
+    if (cache->count >= cache->capacity)
+    {
+        cache->stats.evictions++;
+        remove_entry(cache, cache->lru_tail);
+    }
+
+    struct cached_file **bucket =
+        &cache->buckets[hash_path(file->path) & (cache->bucket_count - 1)];
+    file->hash_next = *bucket;
+    *bucket = file;
+    lru_push_front(cache, file);
+
+    file->cached = true;
+    file->refs++;
+    cache->count++;
+    load_body(cache, file);
+}
+
+struct cached_file *file_cache_open(struct file_cache *cache, const char *path)
+{
+    time_t now = time(NULL);
+    struct cached_file *file = *find_slot(cache, path);
+
+    if (file && is_stale(cache, file, now))
+    {
+        remove_entry(cache, file);
+        file = NULL;
+    }
+
+    // Hit, mark it as the most recently used
+    if (file)
+    {
+        lru_unlink(cache, file);
+        lru_push_front(cache, file);
+        if (file->body)
+        {
+            memory_unlink(cache, file);
+            memory_push_front(cache, file);
+        }
+
+        cache->stats.hits++;
+        file->refs++;
+        return file;
+    }
+
+    cache->stats.misses++;
+    file = open_file(cache, path, now);
+    if (file && cache->capacity)
+        insert_entry(cache, file);
+
+    return file;
+}
+
+struct cached_file *file_cache_retain(struct cached_file *file)
+{
+    file->refs++;
+    return file;
+}
+
+void file_cache_release(struct cached_file *file)
+{
+    if (!file || --file->refs)
+        return;
+
+    if (file->fd != -1)
+        close(file->fd);
+    free(file->body);
+    free(file->path);
+    free(file);
+}
+
+void file_cache_destroy(struct file_cache *cache)
+{
+    if (!cache)
+        return;
+
+    while (cache->lru_head)
+        remove_entry(cache, cache->lru_head);
+
+    free(cache->buckets);
+    free(cache);
+}
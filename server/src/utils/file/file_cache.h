@@ -0,0 +1,141 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <time.h>
+
+// Quoted hexadecimal inode, size and modification time
+#define ETAG_SIZE 64
+// "Sun, 06 Nov 1994 08:49:37 GMT" and its terminator
+#define LAST_MODIFIED_SIZE 30
+
+/*
+** @brief Open file shared by the cache and the responses sending it
+**
+** @param path Resolved path the file was opened from
+** @param fd Read only file descriptor, offsets are never moved. -1 for
+**        files only kept in memory
+** @param size Size of the file when it was opened
+** @param mtime Last modification time of the file
+** @param etag Entity tag derived from the inode, size and mtime
+** @param last_modified mtime formatted for the Last-Modified field
+** @param sidecars Bit i is set when the file has a sibling named after it
+**        with the cache's sidecar_suffixes[i] appended, see file_cache
+** @param checked Last time the entry was checked against the file system
+** @param refs References held by the cache and pending responses
+** @param cached The entry is reachable from the cache
+** @param body Content of small files kept in memory, NULL if not loaded
+*/
+struct cached_file
+{
+    char *path;
+    int fd;
+    off_t size;
+    struct timespec mtime;
+    ino_t ino;
+    dev_t dev;
+    char etag[ETAG_SIZE];
+    char last_modified[LAST_MODIFIED_SIZE];
+    unsigned sidecars;
+    time_t checked;
+    unsigned refs;
+    bool cached;
+    char *body;
+
+    struct cached_file *hash_next;
+    struct cached_file *lru_prev;
+    struct cached_file *lru_next;
+    struct cached_file *memory_prev;
+    struct cached_file *memory_next;
+};
+
+/*
+** @brief Counters of the cache activity
+**
+** @param hits Requests served from a cached entry
+** @param misses Requests that had to open the file
+** @param evictions Entries evicted to make room for another one
+** @param memory_evictions Entries evicted to keep bodies within the memory
+**        budget
+*/
+struct file_cache_stats
+{
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long memory_evictions;
+};
+
+/*
+** @brief Bounded cache of open files keyed by path, evicting the least
+**        recently used entry. Files up to max_body bytes also keep their
+**        content in memory, within memory_budget bytes for the whole cache.
+**        Not thread safe, each worker owns one
+**
+** @param sidecar_suffixes Suffixes of the siblings looked for when a file
+**        is opened or revalidated, NULL terminated. Siblings older than the
+**        file are ignored. NULL, the default, looks for none
+*/
+struct file_cache
+{
+    struct cached_file **buckets;
+    size_t bucket_count;
+    size_t count;
+    size_t capacity;
+
+    struct cached_file *lru_head;
+    struct cached_file *lru_tail;
+
+    size_t memory_used;
+    size_t memory_budget;
+    size_t max_body;
+    struct cached_file *memory_head;
+    struct cached_file *memory_tail;
+
+    const char *const *sidecar_suffixes;
+    struct file_cache_stats stats;
+};
+
+/*
+** @brief Create a cache holding at most capacity open files, 0 disables
+**        caching but file_cache_open keeps working
+**
+** @param capacity Maximum number of cached files
+** @param memory_budget Maximum number of body bytes kept in memory, 0 keeps
+**        no body in memory
+** @param max_body Size above which a file body is not kept in memory
+*/
+struct file_cache *file_cache_create(size_t capacity, size_t memory_budget,
+                                     size_t max_body);
+
+/*
+** @brief Close every cached file not used by a pending response and free the
+**        cache
+*/
+void file_cache_destroy(struct file_cache *cache);
+
+/*
+** @brief Get the open file at path, opening it on a miss. Hits are
+**        revalidated with stat() at most once per second
+**
+** @return a referenced file to give back with file_cache_release, NULL with
+**         errno set if the file cannot be opened
+*/
+struct cached_file *file_cache_open(struct file_cache *cache,
+                                    const char *path);
+
+/*
+** @brief Take another reference on an open file
+**
+** @return file
+*/
+struct cached_file *file_cache_retain(struct cached_file *file);
+
+/*
+** @brief Drop a reference, the file is closed once unreferenced
+*/
+void file_cache_release(struct cached_file *file);
+
+#endif /* ! FILE_CACHE_H */
@@ -6,12 +6,16 @@
 #include <stdlib.h>
 #include <string.h>
 
+// Smallest allocation made when a string grows
+#define STRING_MIN_CAPACITY 64
+
 struct string *string_create(const char *str, size_t size)
 {
     struct string *string = malloc(sizeof(struct string));
     string->data = malloc(size * sizeof(char));
     memcpy(string->data, str, size);
     string->size = size;
+    string->capacity = size;
     return string;
 }
 
@@ -20,15 +24,53 @@ int string_compare_n_str(const struct string *str1, const char *str2, size_t n)
     return memcmp(str1->data, str2, n);
 }
 
-void string_concat_str(struct string *str, const char *to_concat, size_t size)
+bool string_reserve(struct string *str, size_t size)
 {
-    if (!size)
+    if (str->capacity - str->size >= size)
+        return true;
+
+    size_t capacity = str->capacity ? str->capacity : STRING_MIN_CAPACITY;
+    while (capacity - str->size < size)
+        capacity *= 2;
+
+    char *data = realloc(str->data, capacity * sizeof(char));
+    if (!data)
+        return false;
+
+    str->data = data;
+    str->capacity = capacity;
+    return true;
+}
+
+void string_reset(struct string *str)
+{
+    str->size = 0;
+}
+
+void string_shrink(struct string *str, size_t capacity)
+{
+    str->size = 0;
+    if (str->capacity <= capacity)
         return;
 
-    str->data = realloc(str->data, (str->size + size) * sizeof(char));
-    memcpy(str->data + str->size, to_concat, size);
+    char *data = realloc(str->data, capacity * sizeof(char));
+    if (!data)
+        return;
+
+    str->data = data;
+    str->capacity = capacity;
+}
 
+bool string_concat_str(struct string *str, const char *to_concat, size_t size)
+{
+    if (!size)
+        return true;
+    if (!string_reserve(str, size))
+        return false;
+
+    memcpy(str->data + str->size, to_concat, size);
     str->size += size;
+    return true;
 }
 
 bool string_n_casecmp(const char *s1, const char *s2, size_t n)
@@ -5,10 +5,16 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+/*
+ ** @brief Byte string, data holds capacity bytes of which the first size are
+ **        used. Strings viewing another buffer have a capacity of 0 and must
+ **        not be grown
+ */
 struct string
 {
     size_t size;
     char *data;
+    size_t capacity;
 };
 
 /*
@@ -40,8 +46,37 @@ int string_compare_n_str(const struct string *str1, const char *str2, size_t n);
  ** @param str
  ** @param to_concat
  ** @param size
+ **
+ ** @return false if the memory could not be allocated, str is left as is
+ */
+bool string_concat_str(struct string *str, const char *to_concat, size_t size);
+
+/*
+ ** @brief Make room for at least size more bytes, growing the capacity
+ **        geometrically so that appending costs amortized constant time
+ **
+ ** @param str
+ ** @param size
+ **
+ ** @return false if the memory could not be allocated, str is left as is
+ */
+bool string_reserve(struct string *str, size_t size);
+
+/*
+ ** @brief Empty str but keep its memory for the next appends
+ **
+ ** @param str
+ */
+void string_reset(struct string *str);
+
+/*
+ ** @brief Empty str and give back the memory beyond capacity bytes, the
+ **        memory is kept as is if it cannot be shrunk
+ **
+ ** @param str
+ ** @param capacity Capacity to keep, not 0
  */
-void string_concat_str(struct string *str, const char *to_concat, size_t size);
+void string_shrink(struct string *str, size_t capacity);
 
 /*
  ** @brief Perform same operation as strncasecmp(3)
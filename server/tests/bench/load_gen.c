@@ -0,0 +1,469 @@
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_EVENTS 256
+#define HEADER_MAX 4096
+#define READ_SIZE 65536
+#define REQUEST_MAX 1024
+#define INITIAL_SAMPLES 65536
+
+/*
+** @brief Options of a run
+**
+** @param keep_alive Send every request of a client on one connection,
+**        otherwise open a new connection for each request
+*/
+struct options
+{
+    struct sockaddr_in address;
+    char request[REQUEST_MAX];
+    size_t request_size;
+    unsigned connections;
+    unsigned threads;
+    unsigned duration;
+    bool keep_alive;
+    const char *target;
+};
+
+/*
+** @brief Client connection, waiting for the response to one request
+**
+** @param sent Bytes of the request already sent
+** @param header Start of the response, until the end of its header
+** @param body_left Bytes of the body still expected, -1 until the header is
+**        complete
+** @param closing Server closes the connection after this response
+** @param started Time the request started, connection included, in ns
+*/
+struct client
+{
+    int fd;
+    size_t sent;
+    char header[HEADER_MAX];
+    size_t header_size;
+    long long body_left;
+    bool closing;
+    uint64_t started;
+};
+
+/*
+** @brief What one thread measured
+**
+** @param latencies Latency of each response, in ns
+*/
+struct results
+{
+    uint64_t *latencies;
+    size_t count;
+    size_t capacity;
+    uint64_t bytes;
+    uint64_t errors;
+};
+
+struct thread
+{
+    pthread_t id;
+    const struct options *options;
+    unsigned connections;
+    int epoll_fd;
+    struct client *clients;
+    struct results results;
+    char buffer[READ_SIZE];
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void record(struct results *results, uint64_t latency)
+{
+    if (results->count == results->capacity)
+    {
+        size_t capacity =
+            results->capacity ? results->capacity * 2 : INITIAL_SAMPLES;
+        uint64_t *latencies =
+            realloc(results->latencies, capacity * sizeof(uint64_t));
+        if (!latencies)
+            return;
+        results->latencies = latencies;
+        results->capacity = capacity;
+    }
+    results->latencies[results->count++] = latency;
+}
+
+static bool watch(struct thread *thread, struct client *client, uint32_t events,
+                  int op)
+{
+    struct epoll_event event = { .events = events, .data.ptr = client };
+    return !epoll_ctl(thread->epoll_fd, op, client->fd, &event);
+}
+
+static void reset(struct client *client)
+{
+    client->sent = 0;
+    client->header_size = 0;
+    client->body_left = -1;
+    client->closing = false;
+    client->started = now_ns();
+}
+
+static bool open_client(struct thread *thread, struct client *client)
+{
+    reset(client);
+    client->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (client->fd == -1)
+        return false;
+
+    int one = 1;
+    setsockopt(client->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    const struct sockaddr_in *address = &thread->options->address;
+    if (connect(client->fd, (const struct sockaddr *)address, sizeof(*address))
+            == -1
+        && errno != EINPROGRESS)
+    {
+        close(client->fd);
+        return false;
+    }
+    return watch(thread, client, EPOLLOUT, EPOLL_CTL_ADD);
+}
+
+static void reopen_client(struct thread *thread, struct client *client)
+{
+    close(client->fd);
+    if (!open_client(thread, client))
+    {
+        thread->results.errors++;
+        client->fd = -1;
+    }
+}
+
+static void send_request(struct thread *thread, struct client *client)
+{
+    const struct options *options = thread->options;
+    while (client->sent < options->request_size)
+    {
+        ssize_t n = send(client->fd, options->request + client->sent,
+                         options->request_size - client->sent, MSG_NOSIGNAL);
+        if (n == -1 && errno == EAGAIN)
+            return;
+        if (n <= 0)
+        {
+            thread->results.errors++;
+            reopen_client(thread, client);
+            return;
+        }
+        client->sent += n;
+    }
+    watch(thread, client, EPOLLIN, EPOLL_CTL_MOD);
+}
+
+// Value of a field of a complete header, NULL when it is missing
+static const char *find_field(const char *header, const char *field)
+{
+    size_t field_size = strlen(field);
+    for (const char *line = strstr(header, "\r\n"); line;
+         line = strstr(line + 2, "\r\n"))
+        if (!strncasecmp(line + 2, field, field_size))
+            return line + 2 + field_size + strspn(line + 2 + field_size, " ");
+    return NULL;
+}
+
+// Parse the status line and framing of a complete header, false when the
+// response is not a success or cannot be framed
+static bool parse_header(struct client *client)
+{
+    const char *length = find_field(client->header, "Content-Length:");
+    const char *connection = find_field(client->header, "Connection:");
+    client->closing = connection && !strncasecmp(connection, "close", 5);
+    client->body_left = length ? strtoll(length, NULL, 10) : -1;
+    return !strncmp(client->header, "HTTP/1.1 200 ", 13)
+        && client->body_left >= 0;
+}
+
+// Store the start of a response until its header is complete, the bytes
+// after it are part of the body
+static bool read_header(struct client *client, const char *data, size_t size,
+                        size_t *body_size)
+{
+    size_t room = HEADER_MAX - 1 - client->header_size;
+    size_t copied = size < room ? size : room;
+    memcpy(client->header + client->header_size, data, copied);
+    size_t previous = client->header_size;
+    client->header_size += copied;
+    client->header[client->header_size] = '\0';
+
+    // Terminator may straddle two reads
+    size_t from = previous > 3 ? previous - 3 : 0;
+    char *end = strstr(client->header + from, "\r\n\r\n");
+    if (!end)
+    {
+        *body_size = 0;
+        return client->header_size < HEADER_MAX - 1;
+    }
+
+    size_t header_end = end + 4 - client->header;
+    *body_size = size - (header_end - previous);
+    client->header_size = header_end;
+    client->header[header_end] = '\0';
+    return parse_header(client);
+}
+
+static void complete_response(struct thread *thread, struct client *client)
+{
+    record(&thread->results, now_ns() - client->started);
+    thread->results.bytes += client->header_size;
+    if (!thread->options->keep_alive || client->closing)
+    {
+        reopen_client(thread, client);
+        return;
+    }
+
+    reset(client);
+    send_request(thread, client);
+}
+
+static void read_response(struct thread *thread, struct client *client)
+{
+    char *buffer = thread->buffer;
+    ssize_t n;
+    while ((n = recv(client->fd, buffer, READ_SIZE, 0)) > 0)
+    {
+        size_t body_size = n;
+        if (client->body_left < 0)
+        {
+            if (!read_header(client, buffer, n, &body_size))
+                break;
+            if (client->body_left < 0)
+                continue;
+        }
+
+        client->body_left -= body_size;
+        thread->results.bytes += body_size;
+        if (client->body_left < 0)
+            break;
+        if (client->body_left == 0)
+        {
+            complete_response(thread, client);
+            return;
+        }
+    }
+
+    if (n == -1 && errno == EAGAIN)
+        return;
+    // Closed, failed, or answered with something else than the file
+    thread->results.errors++;
+    reopen_client(thread, client);
+}
+
+static void handle_event(struct thread *thread, struct epoll_event *event)
+{
+    struct client *client = event->data.ptr;
+    if (event->events & EPOLLOUT)
+        send_request(thread, client);
+    else
+        read_response(thread, client);
+}
+
+static void *run_thread(void *arg)
+{
+    struct thread *thread = arg;
+    for (unsigned i = 0; i < thread->connections; i++)
+        if (!open_client(thread, &thread->clients[i]))
+            thread->results.errors++;
+
+    uint64_t end = now_ns() + thread->options->duration * 1000000000ULL;
+    struct epoll_event events[MAX_EVENTS];
+    while (now_ns() < end)
+    {
+        int n = epoll_wait(thread->epoll_fd, events, MAX_EVENTS, 100);
+        for (int i = 0; i < n; i++)
+            handle_event(thread, &events[i]);
+    }
+
+    for (unsigned i = 0; i < thread->connections; i++)
+        if (thread->clients[i].fd != -1)
+            close(thread->clients[i].fd);
+    return NULL;
+}
+
+static bool start_threads(struct thread *threads,
+                          const struct options *options)
+{
+    for (unsigned i = 0; i < options->threads; i++)
+    {
+        struct thread *thread = &threads[i];
+        thread->options = options;
+        thread->connections = options->connections / options->threads
+            + (i < options->connections % options->threads);
+        thread->epoll_fd = epoll_create1(0);
+        thread->clients = calloc(thread->connections, sizeof(struct client));
+        if (thread->epoll_fd == -1 || !thread->clients
+            || pthread_create(&thread->id, NULL, run_thread, thread))
+            return false;
+    }
+    return true;
+}
+
+static int compare_latencies(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile_ms(const struct results *results, double percentile)
+{
+    if (!results->count)
+        return 0;
+    size_t rank = percentile * (results->count - 1);
+    return results->latencies[rank] / 1e6;
+}
+
+static void merge_results(struct results *total, struct thread *threads,
+                          unsigned count)
+{
+    for (unsigned i = 0; i < count; i++)
+    {
+        struct results *results = &threads[i].results;
+        for (size_t j = 0; j < results->count; j++)
+            record(total, results->latencies[j]);
+        total->bytes += results->bytes;
+        total->errors += results->errors;
+
+        free(results->latencies);
+        free(threads[i].clients);
+        close(threads[i].epoll_fd);
+    }
+    qsort(total->latencies, total->count, sizeof(uint64_t),
+          compare_latencies);
+}
+
+static void print_results(const struct options *options,
+                          const struct results *total)
+{
+    printf("%s %s, %u connections, %u threads, %u s\n",
+           options->keep_alive ? "keep-alive" : "close", options->target,
+           options->connections, options->threads, options->duration);
+    printf("  requests   %10zu (%llu errors)\n", total->count,
+           (unsigned long long)total->errors);
+    printf("  rate       %10.1f req/s\n",
+           (double)total->count / options->duration);
+    printf("  throughput %10.1f MB/s\n",
+           total->bytes / 1e6 / options->duration);
+    printf("  latency    p50 %.3f ms  p99 %.3f ms  p999 %.3f ms  max %.3f "
+           "ms\n",
+           percentile_ms(total, 0.5), percentile_ms(total, 0.99),
+           percentile_ms(total, 0.999), percentile_ms(total, 1));
+}
+
+static void print_usage(void)
+{
+    fputs("Usage: load-gen [--connections <n>] [--threads <n>] "
+          "[--duration <sec>]\n"
+          "                [--close] [--host <name>] <ip> <port> "
+          "<target>\n",
+          stderr);
+}
+
+static bool parse_options(int argc, char **argv, struct options *options)
+{
+    static const struct option long_options[] = {
+        { "connections", required_argument, NULL, 'c' },
+        { "threads", required_argument, NULL, 't' },
+        { "duration", required_argument, NULL, 'd' },
+        { "close", no_argument, NULL, 'x' },
+        { "host", required_argument, NULL, 'H' },
+        { NULL, 0, NULL, 0 }
+    };
+    const char *host = NULL;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1)
+    {
+        if (opt == 'c')
+            options->connections = strtoul(optarg, NULL, 10);
+        else if (opt == 't')
+            options->threads = strtoul(optarg, NULL, 10);
+        else if (opt == 'd')
+            options->duration = strtoul(optarg, NULL, 10);
+        else if (opt == 'x')
+            options->keep_alive = false;
+        else if (opt == 'H')
+            host = optarg;
+        else
+            return false;
+    }
+    if (argc - optind != 3 || !options->connections || !options->threads
+        || !options->duration)
+        return false;
+
+    const char *ip = argv[optind];
+    const char *port = argv[optind + 1];
+    options->target = argv[optind + 2];
+    options->address.sin_family = AF_INET;
+    options->address.sin_port = htons(strtoul(port, NULL, 10));
+    if (inet_pton(AF_INET, ip, &options->address.sin_addr) != 1)
+        return false;
+
+    // Host defaults to ip:port, the name the server answers to
+    int size = host
+        ? snprintf(options->request, REQUEST_MAX,
+                   "GET %s HTTP/1.1\r\nHost: %s\r\n%s\r\n", options->target,
+                   host, options->keep_alive ? "" : "Connection: close\r\n")
+        : snprintf(options->request, REQUEST_MAX,
+                   "GET %s HTTP/1.1\r\nHost: %s:%s\r\n%s\r\n",
+                   options->target, ip, port,
+                   options->keep_alive ? "" : "Connection: close\r\n");
+    options->request_size = size;
+    return size > 0 && size < REQUEST_MAX;
+}
+
+int main(int argc, char **argv)
+{
+    struct options options = {
+        .connections = 64, .threads = 2, .duration = 5, .keep_alive = true
+    };
+    if (!parse_options(argc, argv, &options))
+    {
+        print_usage();
+        return 2;
+    }
+    if (options.threads > options.connections)
+        options.threads = options.connections;
+
+    struct thread *threads = calloc(options.threads, sizeof(struct thread));
+    if (!threads || !start_threads(threads, &options))
+    {
+        perror("load-gen");
+        return 1;
+    }
+    for (unsigned i = 0; i < options.threads; i++)
+        pthread_join(threads[i].id, NULL);
+
+    struct results total = { 0 };
+    merge_results(&total, threads, options.threads);
+    print_results(&options, &total);
+    free(total.latencies);
+    free(threads);
+
+    // Any failed request is a regression
+    return total.errors || !total.count;
+}
@@ -0,0 +1,60 @@
+#!/usr/bin/env bash
+
+# Serve the bundled game with the server and load it over loopback, with
+# small and large files, on persistent and one-shot connections.
+# Fails when any request fails.
+#
+# Environment:
+#   BENCH_PORT         port the server listens on (default: 8097)
+#   BENCH_DURATION     seconds of each run (default: 5)
+#   BENCH_CONNECTIONS  concurrent connections (default: 64)
+#   BENCH_THREADS      threads of the load generator (default: 2)
+#   BENCH_SERVER_ARGS  extra options of the server, e.g. "--workers 4"
+
+if [ $# -ne 2 ]; then
+    echo "Usage: $0 <server_binary> <load_generator>"
+    exit 2
+fi
+
+SERVER="$1"
+LOAD_GEN="$2"
+PORT="${BENCH_PORT:-8097}"
+DURATION="${BENCH_DURATION:-5}"
+CONNECTIONS="${BENCH_CONNECTIONS:-64}"
+THREADS="${BENCH_THREADS:-2}"
+CORPUS="$(dirname "$0")/../littlegame.tar.gz"
+
+WORK_DIR=$(mktemp -d)
+SERVER_PID=""
+cleanup() {
+    if [ -n "$SERVER_PID" ]; then
+        kill "$SERVER_PID" 2>/dev/null
+        wait "$SERVER_PID" 2>/dev/null
+    fi
+    rm -rf "$WORK_DIR"
+}
+trap cleanup EXIT
+
+tar -xf "$CORPUS" -C "$WORK_DIR" || exit 1
+
+# shellcheck disable=SC2086
+"$SERVER" --pid_file "$WORK_DIR/bench.pid" --server_name bench \
+    --ip 127.0.0.1 --port "$PORT" --root_dir "$WORK_DIR/test_game" \
+    --log false $BENCH_SERVER_ARGS &
+SERVER_PID=$!
+
+for _ in $(seq 50); do
+    (exec 3<>"/dev/tcp/127.0.0.1/$PORT") 2>/dev/null && break
+    sleep 0.1
+done
+
+STATUS=0
+for MODE in "" "--close"; do
+    for TARGET in /index.html /assets/images/icon.png; do
+        # shellcheck disable=SC2086
+        "$LOAD_GEN" --connections "$CONNECTIONS" --threads "$THREADS" \
+            --duration "$DURATION" $MODE 127.0.0.1 "$PORT" "$TARGET" \
+            || STATUS=1
+    done
+done
+exit $STATUS
@@ -134,3 +134,27 @@ def test_log_receive_respond():
             assert f"responding with 200 to 127.0.0.1 for HEAD on '/index.html'" in log_content
         finally:
             teardown(process)
+
+def test_body_not_parsed_as_request():
+    process = setup("/dev/null", ["--pid_file", "/tmp/HTTPd.pid", "--ip", HOST, "--port", PORT, "--root_dir", ROOT_DIR,
+                                  "--server_name", "httpd", "--log", "false"])
+    request = b"GET /index.html HTTP/1.1\r\nHost: " + HOST.encode() + b"\r\n\r\n"
+    s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    s.settimeout(2)
+    s.connect((HOST, int(PORT)))
+    # The body is a request itself, then a real request follows
+    s.sendall(b"POST /index.html HTTP/1.1\r\nHost: " + HOST.encode() + b"\r\nContent-Length: "
+              + str(len(request)).encode() + b"\r\n\r\n" + request + request)
+    data = b""
+    while True:
+        chunk = s.recv(4096)
+        if not chunk:
+            break
+        data += chunk
+    s.close()
+    try:
+        assert data.startswith(b"HTTP/1.1 405 Method Not Allowed")
+        assert b"Connection: close" in data
+        assert b"HTTP/1.1 200" not in data
+    finally:
+        teardown(process)
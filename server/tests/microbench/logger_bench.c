@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../src/config/config.h"
+#include "../../src/http/http.h"
+#include "../../src/logger/logger.h"
+#include "../../src/utils/string/string.h"
+#include "support/bench.h"
+
+#define ITERATIONS 200000
+
+/*
+** @brief Way the logger is set up for a run
+**
+** @param log_buffer Records buffered for the logging thread, 0 formats
+**        them in the benchmark's thread
+** @param binary Log to the binary access log instead of text lines
+*/
+struct log_mode
+{
+    const char *name;
+    unsigned log_buffer;
+    bool binary;
+};
+
+static const struct log_mode modes[] = {
+    { "text, synchronous", 0, false },
+    { "text, log thread", 1024, false },
+    { "binary, synchronous", 0, true },
+};
+
+static const struct string client_ip = { 9, "127.0.0.1", 0 };
+
+// Log what a worker logs for one request, the lines end up in /dev/null
+static void run(const struct log_mode *mode, struct config *config,
+                const struct request_header *req_header)
+{
+    config->log = !mode->binary;
+    config->log_file = "/dev/null";
+    config->log_buffer = mode->log_buffer;
+    config->log_overflow = LOG_OVERFLOW_BLOCK;
+    config->access_log = mode->binary ? "/dev/null" : NULL;
+    if (logger_init(config))
+    {
+        perror("logger_init");
+        return;
+    }
+
+    struct access_stats stats = { .bytes = 1898, .latency = 42 };
+    struct bench_run run;
+    bench_start(&run, mode->name);
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        logger_request(config, req_header, &client_ip);
+        logger_response(config, req_header, &client_ip);
+        logger_access(config, req_header, &client_ip, &stats);
+    }
+    // Lines still buffered are part of the cost
+    logger_destroy();
+    bench_stop(&run, ITERATIONS);
+}
+
+int main(void)
+{
+    struct config config = { 0 };
+    struct server_config server = { 0 };
+    server.server_name = string_create("localhost", 9);
+    server.ip = "127.0.0.1";
+    server.port = "80";
+    server.root_dir = "www";
+    server.default_file = "index.html";
+    config.servers = &server;
+
+    struct request_header *req_header = malloc(sizeof(struct request_header));
+    const struct bench_request *bench_request = &bench_corpus[0];
+    struct string *request = string_create(bench_request->data,
+                                           strlen(bench_request->data));
+    parse_request(request, &config, req_header);
+
+    printf("logger, request and response of '%s', %d iterations\n",
+           bench_request->name, ITERATIONS);
+    for (size_t i = 0; i < sizeof(modes) / sizeof(*modes); i++)
+        run(&modes[i], &config, req_header);
+
+    string_destroy(request);
+    free(req_header);
+    string_destroy(server.server_name);
+    return 0;
+}
@@ -0,0 +1,92 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../src/config/config.h"
+#include "../../src/http/http.h"
+#include "../../src/http/scan.h"
+#include "../../src/utils/string/string.h"
+
+#define ITERATIONS 500000
+
+// Navigation request of a desktop browser
+static const char browser_request[] =
+    "GET /assets/js/app.bundle.min.js?v=3.14.159 HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "Connection: keep-alive\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", "
+    "\"Not-A.Brand\";v=\"99\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+    "(KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+    "sec-ch-ua-platform: \"Linux\"\r\n"
+    "Accept: */*\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "Sec-Fetch-Dest: script\r\n"
+    "Referer: http://localhost/index.html\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Accept-Language: en-US,en;q=0.9,fr;q=0.8\r\n"
+    "Cookie: session=4f9c2a7be13d48e6a0c5d1f2b3e4a5c6; theme=dark; "
+    "_ga=GA1.1.1234567890.1712345678; consent=analytics%3Dfalse\r\n"
+    "If-None-Match: \"5e1a-3c8f-66200e1b\"\r\n"
+    "\r\n";
+
+static double elapsed(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e9
+        + (end.tv_nsec - start->tv_nsec);
+}
+
+static void run(const char *name, struct string *request,
+                const struct config *config)
+{
+    struct request_header *req_header = malloc(sizeof(struct request_header));
+    unsigned long failures = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        parse_request(request, config, req_header);
+        failures += req_header->status != OK;
+    }
+
+    double ns = elapsed(&start) / ITERATIONS;
+    printf("%-8s %8.1f ns/request %8.1f MB/s%s\n", name, ns,
+           request->size / ns * 1e3, failures ? " (parse failed)" : "");
+    free(req_header);
+}
+
+int main(void)
+{
+    struct config config = { 0 };
+    struct server_config server = { 0 };
+    server.server_name = string_create("localhost", 9);
+    server.ip = "127.0.0.1";
+    server.port = "80";
+    server.root_dir = "www";
+    server.default_file = "index.html";
+    config.servers = &server;
+
+    struct string *request =
+        string_create(browser_request, sizeof(browser_request) - 1);
+    printf("parse_request, %zu byte browser request, %d iterations\n",
+           request->size, ITERATIONS);
+
+    scan_use_simd(false);
+    run("scalar", request, &config);
+    if (scan_use_simd(true))
+        run("sse4.2", request, &config);
+    else
+        puts("sse4.2   not supported by this CPU");
+
+    string_destroy(request);
+    string_destroy(server.server_name);
+    return 0;
+}
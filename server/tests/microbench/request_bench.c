@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../src/config/config.h"
+#include "../../src/http/http.h"
+#include "../../src/utils/string/string.h"
+#include "support/bench.h"
+
+#define ITERATIONS 200000
+
+// Smallest requests, parsing them is mostly checking their Host
+static const struct bench_request host_requests[] = {
+    { "host server name", "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n" },
+    { "host ip:port", "GET / HTTP/1.1\r\nHost: 127.0.0.1:80\r\n\r\n" },
+    { "host unknown", "GET / HTTP/1.1\r\nHost: example.com\r\n\r\n" },
+};
+
+static void run(const struct bench_request *bench_request,
+                const struct config *config,
+                struct request_header *req_header)
+{
+    struct string *request = string_create(bench_request->data,
+                                           strlen(bench_request->data));
+    struct bench_run run;
+    bench_start(&run, bench_request->name);
+    for (int i = 0; i < ITERATIONS; i++)
+        parse_request(request, config, req_header);
+    bench_stop(&run, ITERATIONS);
+    string_destroy(request);
+}
+
+int main(void)
+{
+    struct config config = { 0 };
+    struct server_config server = { 0 };
+    server.server_name = string_create("localhost", 9);
+    server.ip = "127.0.0.1";
+    server.port = "80";
+    server.root_dir = "www";
+    server.default_file = "index.html";
+    config.servers = &server;
+    struct request_header *req_header = malloc(sizeof(struct request_header));
+
+    printf("parse_request, %d iterations\n", ITERATIONS);
+    for (size_t i = 0; i < bench_corpus_size; i++)
+        run(&bench_corpus[i], &config, req_header);
+
+    puts("parse_request, Host validation");
+    for (size_t i = 0; i < sizeof(host_requests) / sizeof(*host_requests);
+         i++)
+        run(&host_requests[i], &config, req_header);
+
+    free(req_header);
+    string_destroy(server.server_name);
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../src/config/config.h"
+#include "../../src/http/http.h"
+#include "../../src/utils/arena/arena.h"
+#include "../../src/utils/string/string.h"
+#include "support/bench.h"
+
+#define ITERATIONS 500000
+// Bytes appended per string_concat_str call, about a header field
+#define CONCAT_SIZE 32
+
+static void run_response(const struct bench_request *bench_request,
+                         const struct config *config)
+{
+    struct request_header *req_header = malloc(sizeof(struct request_header));
+    struct string *request = string_create(bench_request->data,
+                                           strlen(bench_request->data));
+    parse_request(request, config, req_header);
+
+    struct http_date date = { 0 };
+    http_date_update(&date, time(NULL));
+    struct arena arena;
+    arena_init(&arena, 4096);
+
+    // Same work as a worker per response, reusing the connection's arena
+    struct bench_run run;
+    bench_start(&run, bench_request->name);
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        struct response_header *response =
+            create_response(req_header, 1725, &date, &arena);
+        response_header_to_parts(response, &arena);
+        arena_reset(&arena);
+    }
+    bench_stop(&run, ITERATIONS);
+
+    arena_destroy(&arena);
+    string_destroy(request);
+    free(req_header);
+}
+
+static void run_concat(void)
+{
+    char chunk[CONCAT_SIZE];
+    memset(chunk, 'a', CONCAT_SIZE);
+    struct string *str = string_create("", 0);
+
+    struct bench_run run;
+    bench_start(&run, "string_concat_str");
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        // Empty it now and then like a request buffer between requests
+        if (i % 64 == 0)
+            string_reset(str);
+        string_concat_str(str, chunk, CONCAT_SIZE);
+    }
+    bench_stop(&run, ITERATIONS);
+    string_destroy(str);
+}
+
+int main(void)
+{
+    struct config config = { 0 };
+    struct server_config server = { 0 };
+    server.server_name = string_create("localhost", 9);
+    server.ip = "127.0.0.1";
+    server.port = "80";
+    server.root_dir = "www";
+    server.default_file = "index.html";
+    config.servers = &server;
+
+    printf("create_response and response_header_to_parts, %d iterations\n",
+           ITERATIONS);
+    for (size_t i = 0; i < bench_corpus_size; i++)
+        run_response(&bench_corpus[i], &config);
+
+    printf("string_concat_str, %d bytes, %d iterations\n", CONCAT_SIZE,
+           ITERATIONS);
+    run_concat();
+
+    string_destroy(server.server_name);
+    return 0;
+}
@@ -0,0 +1,72 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Provided by the linker for each --wrap'ed function
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(const char *str);
+
+// The logger thread allocates too
+static uint64_t allocations = 0;
+
+static void count_allocation(void)
+{
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+}
+
+void *__wrap_malloc(size_t size)
+{
+    count_allocation();
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    count_allocation();
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    count_allocation();
+    return __real_realloc(ptr, size);
+}
+
+char *__wrap_strdup(const char *str)
+{
+    count_allocation();
+    return __real_strdup(str);
+}
+
+uint64_t bench_allocations(void)
+{
+    return __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+void bench_start(struct bench_run *run, const char *name)
+{
+    run->name = name;
+    run->allocations = bench_allocations();
+    run->start = now_ns();
+}
+
+void bench_stop(const struct bench_run *run, size_t operations)
+{
+    double ns = (double)(now_ns() - run->start) / operations;
+    double allocs =
+        (double)(bench_allocations() - run->allocations) / operations;
+    printf("  %-28s %9.1f ns/op %7.2f allocs/op\n", run->name, ns, allocs);
+}
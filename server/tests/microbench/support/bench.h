@@ -0,0 +1,48 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+** @brief Request of the corpus, as received from a real client
+**
+** @param name Client the request was recorded from
+*/
+struct bench_request
+{
+    const char *name;
+    const char *data;
+};
+
+extern const struct bench_request bench_corpus[];
+extern const size_t bench_corpus_size;
+
+/*
+** @brief Measure being taken, see bench_start
+**
+** @param start Time the measure started, in ns
+** @param allocations Allocations made before it started
+*/
+struct bench_run
+{
+    const char *name;
+    uint64_t start;
+    uint64_t allocations;
+};
+
+/*
+** @brief Number of malloc, calloc, realloc and strdup calls made by the
+**        server code so far. Benchmarks are linked with --wrap for each of
+**        them, allocations made inside libc are not counted
+*/
+uint64_t bench_allocations(void);
+
+void bench_start(struct bench_run *run, const char *name);
+
+/*
+** @brief Print the time and allocations per operation since bench_start
+*/
+void bench_stop(const struct bench_run *run, size_t operations);
+
+#endif /* ! BENCH_H */
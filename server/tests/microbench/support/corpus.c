@@ -0,0 +1,88 @@
+#include "bench.h"
+
+// Requests recorded from common clients, with their Host rewritten to the
+// server the benchmarks configure: localhost, 127.0.0.1, port 80
+const struct bench_request bench_corpus[] = {
+    { "chrome page",
+      "GET /index.html HTTP/1.1\r\n"
+      "Host: localhost\r\n"
+      "Connection: keep-alive\r\n"
+      "Cache-Control: max-age=0\r\n"
+      "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", "
+      "\"Not-A.Brand\";v=\"99\"\r\n"
+      "sec-ch-ua-mobile: ?0\r\n"
+      "sec-ch-ua-platform: \"Linux\"\r\n"
+      "Upgrade-Insecure-Requests: 1\r\n"
+      "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+      "(KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+      "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,"
+      "image/avif,image/webp,image/apng,*/*;q=0.8,"
+      "application/signed-exchange;v=b3;q=0.7\r\n"
+      "Sec-Fetch-Site: none\r\n"
+      "Sec-Fetch-Mode: navigate\r\n"
+      "Sec-Fetch-User: ?1\r\n"
+      "Sec-Fetch-Dest: document\r\n"
+      "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+      "Accept-Language: en-US,en;q=0.9,fr;q=0.8\r\n"
+      "\r\n" },
+    { "firefox asset",
+      "GET /assets/images/icon.png HTTP/1.1\r\n"
+      "Host: localhost\r\n"
+      "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:125.0) Gecko/20100101 "
+      "Firefox/125.0\r\n"
+      "Accept: image/avif,image/webp,*/*\r\n"
+      "Accept-Language: en-US,en;q=0.5\r\n"
+      "Accept-Encoding: gzip, deflate, br\r\n"
+      "Connection: keep-alive\r\n"
+      "Referer: http://localhost/index.html\r\n"
+      "Cookie: session=4f9c2a7be13d48e6a0c5d1f2b3e4a5c6; theme=dark\r\n"
+      "Sec-Fetch-Dest: image\r\n"
+      "Sec-Fetch-Mode: no-cors\r\n"
+      "Sec-Fetch-Site: same-origin\r\n"
+      "If-Modified-Since: Mon, 20 Oct 2025 10:15:00 GMT\r\n"
+      "If-None-Match: \"13e7fb-68f60c54\"\r\n"
+      "\r\n" },
+    { "safari mobile",
+      "GET /css/style.css HTTP/1.1\r\n"
+      "Host: localhost\r\n"
+      "Accept: text/css,*/*;q=0.1\r\n"
+      "Accept-Language: fr-FR,fr;q=0.9\r\n"
+      "Connection: keep-alive\r\n"
+      "Accept-Encoding: gzip, deflate\r\n"
+      "User-Agent: Mozilla/5.0 (iPhone; CPU iPhone OS 17_4 like Mac OS X) "
+      "AppleWebKit/605.1.15 (KHTML, like Gecko) Version/17.4 Mobile/15E148 "
+      "Safari/604.1\r\n"
+      "Referer: http://localhost/\r\n"
+      "\r\n" },
+    { "curl",
+      "GET /js/script.js HTTP/1.1\r\n"
+      "Host: 127.0.0.1:80\r\n"
+      "User-Agent: curl/8.5.0\r\n"
+      "Accept: */*\r\n"
+      "\r\n" },
+    { "health check",
+      "HEAD / HTTP/1.1\r\n"
+      "Host: 127.0.0.1\r\n"
+      "User-Agent: ELB-HealthChecker/2.0\r\n"
+      "Connection: close\r\n"
+      "\r\n" },
+    { "crawler",
+      "GET /success.html HTTP/1.1\r\n"
+      "Host: localhost\r\n"
+      "User-Agent: Mozilla/5.0 (compatible; Googlebot/2.1; "
+      "+http://www.google.com/bot.html)\r\n"
+      "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,"
+      "*/*;q=0.8\r\n"
+      "Accept-Encoding: gzip, deflate, br\r\n"
+      "From: googlebot(at)googlebot.com\r\n"
+      "\r\n" },
+    { "scanner",
+      "GET /../../etc/passwd HTTP/1.0\r\n"
+      "Host: 203.0.113.7\r\n"
+      "User-Agent: Mozilla/5.0 zgrab/0.x\r\n"
+      "Accept: */*\r\n"
+      "\r\n" },
+};
+
+const size_t bench_corpus_size =
+    sizeof(bench_corpus) / sizeof(bench_corpus[0]);
@@ -0,0 +1,48 @@
+#include <criterion/criterion.h>
+#include <string.h>
+
+#include "../../src/logger/access_log.h"
+
+TestSuite(access_log);
+
+Test(access_log, record_round_trip)
+{
+    struct access_entry entry = {
+        .time = 1760670000,
+        .client_ip = 0x7f000001,
+        .latency = 1234,
+        .bytes = 5000000000ULL,
+        .status = 404,
+        .method = 1,
+        .target_length = 11,
+        .target = "/index.html",
+    };
+    unsigned char buffer[ACCESS_RECORD_FIXED_SIZE + 11];
+    size_t size = access_log_encode(&entry, buffer);
+    cr_assert_eq(size, sizeof(buffer));
+
+    struct access_entry decoded;
+    cr_expect_eq(access_log_decode(buffer, size - 1, &decoded), 0,
+                 "Partial record should not be decoded");
+    cr_assert_eq(access_log_decode(buffer, size, &decoded), size);
+    cr_expect_eq(decoded.time, entry.time);
+    cr_expect_eq(decoded.client_ip, entry.client_ip);
+    cr_expect_eq(decoded.latency, entry.latency);
+    cr_expect_eq(decoded.bytes, entry.bytes);
+    cr_expect_eq(decoded.status, entry.status);
+    cr_expect_eq(decoded.method, entry.method);
+    cr_assert_eq(decoded.target_length, entry.target_length);
+    cr_expect(!memcmp(decoded.target, "/index.html", 11));
+}
+
+Test(access_log, header_is_checked)
+{
+    unsigned char header[ACCESS_LOG_HEADER_SIZE];
+    size_t size = access_log_header(header);
+
+    cr_expect(access_log_check_header(header, size));
+    cr_expect(!access_log_check_header(header, size - 1));
+    header[4]++;
+    cr_expect(!access_log_check_header(header, size),
+              "Other versions should be refused");
+}
@@ -0,0 +1,68 @@
+#include <criterion/criterion.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../../src/utils/arena/arena.h"
+
+TestSuite(arena);
+
+Test(arena, allocations_are_aligned)
+{
+    struct arena arena;
+    arena_init(&arena, 256);
+
+    for (size_t size = 1; size < 100; size += 7)
+    {
+        char *memory = arena_alloc(&arena, size);
+        cr_assert_not_null(memory);
+        cr_expect_eq((uintptr_t)memory % ARENA_ALIGNMENT, 0,
+                     "Allocation of %zu bytes is misaligned", size);
+        memset(memory, 0xab, size);
+    }
+
+    arena_destroy(&arena);
+}
+
+Test(arena, reset_reuses_blocks)
+{
+    struct arena arena;
+    arena_init(&arena, 256);
+
+    char *first = arena_alloc(&arena, 200);
+    arena_alloc(&arena, 200);
+    char *large = arena_alloc(&arena, 1000);
+    cr_assert_not_null(large, "Large allocations get their own block");
+    struct arena_block *blocks = arena.first;
+
+    arena_reset(&arena);
+    cr_expect_eq(arena_alloc(&arena, 200), first, "Memory should be reused");
+    arena_alloc(&arena, 200);
+    cr_expect_not_null(arena_alloc(&arena, 1000));
+    cr_expect_eq(arena.first, blocks, "No block should be allocated");
+    cr_expect_null(arena.current->next, "Every block should be in use");
+
+    arena_destroy(&arena);
+}
+
+Test(arena, trim_keeps_first_block)
+{
+    struct arena arena;
+    arena_init(&arena, 256);
+
+    char *first = arena_alloc(&arena, 200);
+    for (int i = 0; i < 8; i++)
+        cr_assert_not_null(arena_alloc(&arena, 200));
+    cr_assert_not_null(arena_alloc(&arena, 1000));
+    struct arena_block *block = arena.first;
+
+    arena_trim(&arena);
+    cr_expect_eq(arena.first, block, "First block should be kept");
+    cr_expect_null(arena.first->next, "Other blocks should be freed");
+    cr_expect_eq(arena.current, arena.first);
+    cr_expect_eq(arena_alloc(&arena, 200), first, "Memory should be reused");
+
+    arena_trim(&arena);
+    arena_destroy(&arena);
+    arena_trim(&arena);
+    cr_expect_null(arena.first, "Empty arena should stay empty");
+}
@@ -0,0 +1,139 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <criterion/criterion.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "../../src/compress/compress_cache.h"
+#include "../../src/compress/compressor.h"
+
+#define TEXT_SIZE 4096
+
+static char root[] = "/tmp/compress_testsXXXXXX";
+static char text[TEXT_SIZE + 1];
+
+static void write_file(const char *name, const char *content, char *path)
+{
+    sprintf(path, "%s/%s", root, name);
+    FILE *f = fopen(path, "w");
+    cr_assert_not_null(f, "Could not create %s", path);
+    fputs(content, f);
+    fclose(f);
+}
+
+static void setup(void)
+{
+    // Assertions can evaluate their arguments more than once
+    char *dir = mkdtemp(root);
+    cr_assert_not_null(dir, "Could not create test directory");
+    for (size_t i = 0; i < TEXT_SIZE; i++)
+        text[i] = "<p>compress me</p>\n"[i % 19];
+
+    struct config config = { .compress_threads = 2 };
+    cr_assert(compress_init(&config), "Compressing threads should start");
+}
+
+static void teardown(void)
+{
+    compress_destroy();
+    char cmd[64];
+    sprintf(cmd, "rm -rf %s", root);
+    system(cmd);
+}
+
+TestSuite(compress, .init = setup, .fini = teardown);
+
+// Ask until the compressing threads handed the file back
+static struct cached_file *wait_compressed(struct compress_cache *cache,
+                                           const struct cached_file *file)
+{
+    struct timespec pause = { 0, 1000000 };
+    for (int i = 0; i < 2000; i++)
+    {
+        struct cached_file *compressed =
+            compress_cache_get(cache, file, CODING_GZIP);
+        if (compressed)
+            return compressed;
+        nanosleep(&pause, NULL);
+    }
+    return NULL;
+}
+
+Test(compress, compresses_once)
+{
+    char path[64];
+    write_file("page.html", text, path);
+    struct file_cache *files = file_cache_create(4, 0, 0);
+    struct cached_file *file = file_cache_open(files, path);
+    struct compress_cache *cache = compress_cache_create(1 << 20);
+    cr_assert_not_null(file);
+    cr_expect_eq(compress_cache_codings(cache, file), 1u << CODING_GZIP);
+
+    cr_expect_null(compress_cache_get(cache, file, CODING_GZIP),
+                   "File should be sent as is while being compressed");
+    struct cached_file *compressed = wait_compressed(cache, file);
+    cr_assert_not_null(compressed, "File should get compressed");
+    cr_expect_eq(cache->stats.misses, 1, "File should be compressed once");
+    cr_expect(compressed->size < file->size);
+    cr_expect_eq(compressed->fd, -1, "Compressed file is only in memory");
+    cr_expect(strcmp(compressed->etag, file->etag), "ETag should differ");
+    cr_expect_str_eq(compressed->last_modified, file->last_modified);
+
+    char out[TEXT_SIZE];
+    z_stream stream = { 0 };
+    inflateInit2(&stream, 15 + 16);
+    stream.next_in = (Bytef *)compressed->body;
+    stream.avail_in = compressed->size;
+    stream.next_out = (Bytef *)out;
+    stream.avail_out = TEXT_SIZE;
+    cr_expect_eq(inflate(&stream, Z_FINISH), Z_STREAM_END);
+    cr_expect_eq(stream.total_out, TEXT_SIZE);
+    cr_expect(!memcmp(out, text, TEXT_SIZE), "Body should inflate back");
+    inflateEnd(&stream);
+
+    file_cache_release(compressed);
+    file_cache_release(file);
+    compress_cache_destroy(cache);
+    file_cache_destroy(files);
+}
+
+Test(compress, skips_unsuitable_files)
+{
+    char path[64];
+    char image[64];
+    char tiny[64];
+    write_file("photo.png", text, image);
+    write_file("tiny.txt", "hello", tiny);
+    // Random bytes do not get smaller
+    sprintf(path, "%s/noise.txt", root);
+    FILE *f = fopen(path, "w");
+    cr_assert_not_null(f);
+    srand(42);
+    for (int i = 0; i < TEXT_SIZE; i++)
+        fputc(rand() & 0xff, f);
+    fclose(f);
+
+    struct file_cache *files = file_cache_create(4, 0, 0);
+    struct compress_cache *cache = compress_cache_create(1 << 20);
+    struct cached_file *file = file_cache_open(files, image);
+    cr_expect_eq(compress_cache_codings(cache, file), 0);
+    file_cache_release(file);
+    file = file_cache_open(files, tiny);
+    cr_expect_eq(compress_cache_codings(cache, file), 0);
+    file_cache_release(file);
+
+    file = file_cache_open(files, path);
+    cr_expect_null(compress_cache_get(cache, file, CODING_GZIP));
+    struct timespec pause = { 0, 50000000 };
+    nanosleep(&pause, NULL);
+    cr_expect_null(compress_cache_get(cache, file, CODING_GZIP));
+    cr_expect_eq(cache->stats.misses, 1, "Result should be remembered");
+
+    file_cache_release(file);
+    compress_cache_destroy(cache);
+    file_cache_destroy(files);
+}
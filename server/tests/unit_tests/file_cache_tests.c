@@ -0,0 +1,172 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <criterion/criterion.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../src/utils/file/file_cache.h"
+
+static char root[] = "/tmp/file_cache_testsXXXXXX";
+
+static void write_file(const char *name, const char *content, char *path)
+{
+    sprintf(path, "%s/%s", root, name);
+    FILE *f = fopen(path, "w");
+    cr_assert_not_null(f, "Could not create %s", path);
+    fputs(content, f);
+    fclose(f);
+}
+
+static void setup(void)
+{
+    cr_assert_not_null(mkdtemp(root), "Could not create test directory");
+}
+
+static void teardown(void)
+{
+    char cmd[64];
+    sprintf(cmd, "rm -rf %s", root);
+    system(cmd);
+}
+
+TestSuite(file_cache, .init = setup, .fini = teardown);
+
+Test(file_cache, hit_returns_same_file)
+{
+    char path[64];
+    write_file("a.txt", "hello", path);
+
+    struct file_cache *cache = file_cache_create(4, 0, 0);
+    struct cached_file *first = file_cache_open(cache, path);
+    struct cached_file *second = file_cache_open(cache, path);
+
+    cr_assert_not_null(first, "File should open");
+    cr_expect_eq(first, second, "Second open should hit the cache");
+    cr_expect_eq(first->size, 5, "Expected size 5, got %jd",
+                 (intmax_t)first->size);
+    cr_expect_eq(first->etag[0], '"', "ETag should be quoted");
+    cr_expect_eq(first->refs, 3, "Cache and both callers hold a reference");
+
+    file_cache_release(first);
+    file_cache_release(second);
+    file_cache_destroy(cache);
+}
+
+Test(file_cache, evicts_least_recently_used)
+{
+    char a[64];
+    char b[64];
+    char c[64];
+    write_file("a.txt", "a", a);
+    write_file("b.txt", "b", b);
+    write_file("c.txt", "c", c);
+
+    struct file_cache *cache = file_cache_create(2, 0, 0);
+    file_cache_release(file_cache_open(cache, a));
+    file_cache_release(file_cache_open(cache, b));
+    file_cache_release(file_cache_open(cache, a));
+    file_cache_release(file_cache_open(cache, c));
+
+    cr_expect_eq(cache->count, 2, "Cache should stay bounded");
+    cr_expect_str_eq(cache->lru_head->path, c, "Newest entry comes first");
+    cr_expect_str_eq(cache->lru_tail->path, a, "b should have been evicted");
+
+    file_cache_destroy(cache);
+}
+
+Test(file_cache, evicted_file_stays_open_while_referenced)
+{
+    char a[64];
+    char b[64];
+    write_file("a.txt", "a", a);
+    write_file("b.txt", "b", b);
+
+    struct file_cache *cache = file_cache_create(1, 0, 0);
+    struct cached_file *file = file_cache_open(cache, a);
+    file_cache_release(file_cache_open(cache, b));
+
+    cr_expect_not(file->cached, "a should have been evicted");
+    cr_expect_neq(fcntl(file->fd, F_GETFD), -1, "a should still be open");
+
+    file_cache_release(file);
+    file_cache_destroy(cache);
+}
+
+Test(file_cache, small_body_kept_in_memory)
+{
+    char small[64];
+    char large[64];
+    write_file("small.txt", "hello", small);
+    write_file("large.txt", "hello world", large);
+
+    struct file_cache *cache = file_cache_create(4, 64, 8);
+    struct cached_file *file = file_cache_open(cache, small);
+    cr_assert_not_null(file->body, "Small body should be in memory");
+    cr_expect(memcmp(file->body, "hello", 5) == 0, "Body does not match");
+    file_cache_release(file);
+
+    file = file_cache_open(cache, large);
+    cr_expect_null(file->body, "Body above max_body should stay on disk");
+    cr_expect_eq(cache->memory_used, 5, "Expected 5 bytes in memory, got %zu",
+                 cache->memory_used);
+    file_cache_release(file);
+
+    file_cache_destroy(cache);
+}
+
+Test(file_cache, memory_budget_evicts_bodies)
+{
+    char a[64];
+    char b[64];
+    write_file("a.txt", "aaaa", a);
+    write_file("b.txt", "bbbb", b);
+
+    struct file_cache *cache = file_cache_create(4, 6, 8);
+    struct cached_file *first = file_cache_open(cache, a);
+    file_cache_release(file_cache_open(cache, b));
+
+    cr_expect_not(first->cached, "a should have been evicted");
+    cr_expect(memcmp(first->body, "aaaa", 4) == 0,
+              "Body should live as long as its references");
+    cr_expect_eq(cache->memory_used, 4, "Only b should be in memory");
+    cr_expect_eq(cache->stats.memory_evictions, 1, "Expected one eviction");
+
+    file_cache_release(first);
+    file_cache_destroy(cache);
+}
+
+Test(file_cache, missing_file_and_directory)
+{
+    char path[64];
+    sprintf(path, "%s/missing", root);
+
+    struct file_cache *cache = file_cache_create(4, 0, 0);
+    cr_expect_null(file_cache_open(cache, path), "Missing file should fail");
+    cr_expect_eq(errno, ENOENT, "Expected ENOENT, got %d", errno);
+    cr_expect_null(file_cache_open(cache, root), "Directory should fail");
+    cr_expect_eq(errno, EISDIR, "Expected EISDIR, got %d", errno);
+    cr_expect_eq(cache->count, 0, "Failures should not be cached");
+
+    file_cache_destroy(cache);
+}
+
+Test(file_cache, disabled_cache_still_opens)
+{
+    char path[64];
+    write_file("a.txt", "hello", path);
+
+    struct file_cache *cache = file_cache_create(0, 0, 0);
+    struct cached_file *file = file_cache_open(cache, path);
+
+    cr_assert_not_null(file, "File should open");
+    cr_expect_not(file->cached, "Nothing should be cached");
+    cr_expect_eq(file->refs, 1, "Only the caller holds a reference");
+
+    file_cache_release(file);
+    file_cache_destroy(cache);
+}
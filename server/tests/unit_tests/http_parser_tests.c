@@ -6,6 +6,7 @@
 #include <string.h>
 
 #include "../../src/http/http.h"
+#include "../../src/http/scan.h"
 #include "../../src/utils/string/string.h"
 
 static struct string *make_request(const char *s)
@@ -47,13 +48,14 @@ Test(http_parser, malformed_status_line)
     const char *request = "G ET / HTTP/1.1\r\nHost: example.com\r\n\r\n";
     struct string *r = make_request(request);
     struct config *config = make_config_with_server_name("example.com");
-    struct request_header *req_header = parse_request(r, config);
+    struct request_header header;
+    struct request_header *req_header = &header;
+    parse_request(r, config, req_header);
 
     cr_expect_not_null(req_header);
     if (req_header)
     {
         cr_expect_eq(req_header->status, BAD_REQUEST);
-        destroy_request(req_header);
         config_destroy(config);
     }
     string_destroy(r);
@@ -64,13 +66,14 @@ Test(http_parser, unsupported_http_version)
     const char *request = "GET / HTTP/2.0\r\nHost: example.com\r\n\r\n";
     struct string *r = make_request(request);
     struct config *config = make_config_with_server_name("example.com");
-    struct request_header *req_header = parse_request(r, config);
+    struct request_header header;
+    struct request_header *req_header = &header;
+    parse_request(r, config, req_header);
 
     cr_expect_not_null(req_header);
     if (req_header)
     {
         cr_expect_eq(req_header->status, UNSUPPORTED_VERSION);
-        destroy_request(req_header);
         config_destroy(config);
     }
     string_destroy(r);
@@ -81,13 +84,14 @@ Test(http_parser, invalid_header_field_name_space)
     const char *request = "GET / HTTP/1.1\r\nBad Name: v\r\n\r\n";
     struct string *r = make_request(request);
     struct config *config = make_config_with_server_name("example.com");
-    struct request_header *req_header = parse_request(r, config);
+    struct request_header header;
+    struct request_header *req_header = &header;
+    parse_request(r, config, req_header);
 
     cr_expect_not_null(req_header);
     if (req_header)
     {
         cr_expect_eq(req_header->status, BAD_REQUEST);
-        destroy_request(req_header);
         config_destroy(config);
     }
     string_destroy(r);
@@ -98,13 +102,14 @@ Test(http_parser, request_target_with_space)
     const char *request = "GET /foo bar HTTP/1.1\r\nHost: example.com\r\n\r\n";
     struct string *r = make_request(request);
     struct config *config = make_config_with_server_name("example.com");
-    struct request_header *req_header = parse_request(r, config);
+    struct request_header header;
+    struct request_header *req_header = &header;
+    parse_request(r, config, req_header);
 
     cr_expect_not_null(req_header);
     if (req_header)
     {
         cr_expect_eq(req_header->status, BAD_REQUEST);
-        destroy_request(req_header);
         config_destroy(config);
     }
     string_destroy(r);
@@ -115,19 +120,20 @@ Test(http_parser, host_valid_ip_port)
     const char *request = "GET / HTTP/1.1\r\nHost: 127.0.0.1:8080\r\n\r\n";
     struct string *r = make_request(request);
     struct config *config = make_config_with_ip_port("127.0.0.1", "8080");
-    struct request_header *req_header = parse_request(r, config);
+    struct request_header header;
+    struct request_header *req_header = &header;
+    parse_request(r, config, req_header);
 
     cr_expect_not_null(req_header);
     if (req_header)
     {
         cr_expect_eq(req_header->status, OK);
-        cr_expect_not_null(req_header->host);
-        if (req_header->host)
+        cr_expect_not_null(req_header->host.data);
+        if (req_header->host.data)
             cr_expect_eq(0,
-                         strncmp(req_header->host->data, "127.0.0.1:8080",
+                         strncmp(req_header->host.data, "127.0.0.1:8080",
                                  strlen("127.0.0.1:8080")));
 
-        destroy_request(req_header);
         config_destroy(config);
     }
     string_destroy(r);
@@ -139,7 +145,9 @@ Test(http_parser, valid_get_request)
         "GET /index.html HTTP/1.1\r\nHost: example.com\r\n\r\n";
     struct string *r = make_request(request);
     struct config *config = make_config_with_server_name("example.com");
-    struct request_header *req_header = parse_request(r, config);
+    struct request_header header;
+    struct request_header *req_header = &header;
+    parse_request(r, config, req_header);
 
     cr_expect_not_null(req_header, "parse_request returned NULL");
     if (req_header)
@@ -147,18 +155,14 @@ Test(http_parser, valid_get_request)
         cr_expect_eq(req_header->status, OK, "expected OK status but got %d",
                      req_header->status);
         cr_expect_eq(req_header->method, GET, "expected GET method");
-        cr_expect_not_null(req_header->filename, "filename not set");
-        if (req_header->filename)
+        cr_expect_str_eq(req_header->filename, "/index.html",
+                         "unexpected filename %s", req_header->filename);
+        cr_expect_not_null(req_header->host.data, "host not set");
+        if (req_header->host.data)
             cr_expect_eq(0,
-                         strncmp(req_header->filename->data, "/index.html",
-                                 strlen("/index.html")));
-        cr_expect_not_null(req_header->host, "host not set");
-        if (req_header->host)
-            cr_expect_eq(0,
-                         strncmp(req_header->host->data, "example.com",
+                         strncmp(req_header->host.data, "example.com",
                                  strlen("example.com")));
 
-        destroy_request(req_header);
         config_destroy(config);
     }
     string_destroy(r);
@@ -169,22 +173,20 @@ Test(http_parser, valid_head_request)
     const char *request = "HEAD /foo HTTP/1.1\r\nHost: a\r\n\r\n";
     struct string *r = make_request(request);
     struct config *config = make_config_with_server_name("a");
-    struct request_header *req_header = parse_request(r, config);
+    struct request_header header;
+    struct request_header *req_header = &header;
+    parse_request(r, config, req_header);
 
     cr_expect_not_null(req_header);
     if (req_header)
     {
         cr_expect_eq(req_header->status, OK);
         cr_expect_eq(req_header->method, HEAD);
-        cr_expect_not_null(req_header->filename);
-        if (req_header->filename)
-            cr_expect_eq(
-                0, strncmp(req_header->filename->data, "/foo", strlen("/foo")));
-        cr_expect_not_null(req_header->host);
-        if (req_header->host)
-            cr_expect_eq(0, strncmp(req_header->host->data, "a", strlen("a")));
-
-        destroy_request(req_header);
+        cr_expect_str_eq(req_header->filename, "/foo");
+        cr_expect_not_null(req_header->host.data);
+        if (req_header->host.data)
+            cr_expect_eq(0, strncmp(req_header->host.data, "a", strlen("a")));
+
         config_destroy(config);
     }
     string_destroy(r);
@@ -195,14 +197,15 @@ Test(http_parser, malformed_header_name)
     const char *request = "GET / HTTP/1.1\r\nBad!Name: value\r\n\r\n";
     struct string *r = make_request(request);
     struct config *config = make_config_with_server_name("example.com");
-    struct request_header *req_header = parse_request(r, config);
+    struct request_header header;
+    struct request_header *req_header = &header;
+    parse_request(r, config, req_header);
 
     cr_expect_not_null(req_header);
     if (req_header)
     {
         cr_expect(req_header->status == OK
                   || req_header->status == BAD_REQUEST);
-        destroy_request(req_header);
         config_destroy(config);
     }
     string_destroy(r);
@@ -213,13 +216,14 @@ Test(http_parser, missing_host_header)
     const char *request = "GET / HTTP/1.1\r\n\r\n";
     struct string *r = make_request(request);
     struct config *config = make_config_with_server_name("example.com");
-    struct request_header *req_header = parse_request(r, config);
+    struct request_header header;
+    struct request_header *req_header = &header;
+    parse_request(r, config, req_header);
 
     cr_expect_not_null(req_header);
     if (req_header)
     {
         cr_expect_eq(req_header->status, BAD_REQUEST);
-        destroy_request(req_header);
         config_destroy(config);
     }
     string_destroy(r);
@@ -231,13 +235,14 @@ Test(http_parser, multiple_host_header)
         "GET / HTTP/1.1\r\nHost: example.com\r\nHost: example.com\r\n\r\n";
     struct string *r = make_request(request);
     struct config *config = make_config_with_server_name("example.com");
-    struct request_header *req_header = parse_request(r, config);
+    struct request_header header;
+    struct request_header *req_header = &header;
+    parse_request(r, config, req_header);
 
     cr_expect_not_null(req_header);
     if (req_header)
     {
         cr_expect_eq(req_header->status, BAD_REQUEST);
-        destroy_request(req_header);
         config_destroy(config);
     }
     string_destroy(r);
@@ -248,13 +253,14 @@ Test(http_parser, unfinished_ip_host)
     const char *request = "GET / HTTP/1.1\r\nHost: 127.0.0\r\n\r\n";
     struct string *r = make_request(request);
     struct config *config = make_config_with_ip_port("127.0.0.1", "80");
-    struct request_header *req_header = parse_request(r, config);
+    struct request_header header;
+    struct request_header *req_header = &header;
+    parse_request(r, config, req_header);
 
     cr_expect_not_null(req_header);
     if (req_header)
     {
         cr_expect_eq(req_header->status, BAD_REQUEST);
-        destroy_request(req_header);
         config_destroy(config);
     }
     string_destroy(r);
@@ -265,13 +271,14 @@ Test(http_parser, ip_with_empty_port_host)
     const char *request = "GET / HTTP/1.1\r\nHost: 127.0.0.1:\r\n\r\n";
     struct string *r = make_request(request);
     struct config *config = make_config_with_ip_port("127.0.0.1", "880");
-    struct request_header *req_header = parse_request(r, config);
+    struct request_header header;
+    struct request_header *req_header = &header;
+    parse_request(r, config, req_header);
 
     cr_expect_not_null(req_header);
     if (req_header)
     {
         cr_expect_eq(req_header->status, BAD_REQUEST);
-        destroy_request(req_header);
         config_destroy(config);
     }
     string_destroy(r);
@@ -282,14 +289,490 @@ Test(http_parser, unspecified_port_server_port_80)
     const char *request = "GET / HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
     struct string *r = make_request(request);
     struct config *config = make_config_with_ip_port("127.0.0.1", "80");
-    struct request_header *req_header = parse_request(r, config);
+    struct request_header header;
+    struct request_header *req_header = &header;
+    parse_request(r, config, req_header);
 
     cr_expect_not_null(req_header);
     if (req_header)
     {
         cr_expect_eq(req_header->status, OK);
-        destroy_request(req_header);
         config_destroy(config);
     }
     string_destroy(r);
 }
+
+Test(http_parser, http_1_1_defaults_to_keep_alive)
+{
+    const char *request = "GET / HTTP/1.1\r\nHost: example.com\r\n\r\n";
+    struct string *r = make_request(request);
+    struct config *config = make_config_with_server_name("example.com");
+    struct request_header header;
+    struct request_header *req_header = &header;
+    parse_request(r, config, req_header);
+
+    cr_expect_not_null(req_header);
+    if (req_header)
+    {
+        cr_expect_eq(req_header->status, OK);
+        cr_expect(req_header->keep_alive);
+        config_destroy(config);
+    }
+    string_destroy(r);
+}
+
+Test(http_parser, connection_close)
+{
+    const char *request =
+        "GET / HTTP/1.1\r\nHost: example.com\r\nConnection: close\r\n\r\n";
+    struct string *r = make_request(request);
+    struct config *config = make_config_with_server_name("example.com");
+    struct request_header header;
+    struct request_header *req_header = &header;
+    parse_request(r, config, req_header);
+
+    cr_expect_not_null(req_header);
+    if (req_header)
+    {
+        cr_expect_eq(req_header->status, OK);
+        cr_expect_not(req_header->keep_alive);
+        config_destroy(config);
+    }
+    string_destroy(r);
+}
+
+Test(http_parser, http_1_0_defaults_to_close)
+{
+    const char *request = "GET / HTTP/1.0\r\nHost: example.com\r\n\r\n";
+    struct string *r = make_request(request);
+    struct config *config = make_config_with_server_name("example.com");
+    struct request_header header;
+    struct request_header *req_header = &header;
+    parse_request(r, config, req_header);
+
+    cr_expect_not_null(req_header);
+    if (req_header)
+    {
+        cr_expect_eq(req_header->status, OK);
+        cr_expect_not(req_header->keep_alive);
+        config_destroy(config);
+    }
+    string_destroy(r);
+}
+
+Test(http_parser, http_1_0_host_optional)
+{
+    struct string *r = make_request("GET / HTTP/1.0\r\n\r\n");
+    struct config *config = make_config_with_server_name("example.com");
+    struct request_header header;
+    parse_request(r, config, &header);
+    cr_expect_eq(header.status, OK, "HTTP/1.0 does not require Host");
+    string_destroy(r);
+
+    r = make_request("GET / HTTP/1.0\r\nHost: other.com\r\n\r\n");
+    parse_request(r, config, &header);
+    cr_expect_eq(header.status, BAD_REQUEST, "Host received is checked");
+    string_destroy(r);
+    config_destroy(config);
+}
+
+Test(http_parser, http_1_0_connection_keep_alive)
+{
+    const char *request = "GET / HTTP/1.0\r\nHost: example.com\r\n"
+                          "Connection: Keep-Alive\r\n\r\n";
+    struct string *r = make_request(request);
+    struct config *config = make_config_with_server_name("example.com");
+    struct request_header header;
+    struct request_header *req_header = &header;
+    parse_request(r, config, req_header);
+
+    cr_expect_not_null(req_header);
+    if (req_header)
+    {
+        cr_expect_eq(req_header->status, OK);
+        cr_expect(req_header->keep_alive);
+        config_destroy(config);
+    }
+    string_destroy(r);
+}
+
+Test(http_parser, fields_point_into_request)
+{
+    const char *request = "GET /a/b.css HTTP/1.1\r\nHost: example.com\r\n\r\n";
+    struct string *r = make_request(request);
+    struct config *config = make_config_with_server_name("example.com");
+    struct request_header req_header;
+    parse_request(r, config, &req_header);
+
+    cr_expect_eq(req_header.status, OK);
+    cr_expect_eq(req_header.target.data, r->data + 4,
+                 "target should be a view into the request");
+    cr_expect_eq(req_header.target.size, strlen("/a/b.css"));
+    cr_expect_eq(req_header.host.data, r->data + 29,
+                 "host should be a view into the request");
+    cr_expect_eq(req_header.host.size, strlen("example.com"));
+
+    config_destroy(config);
+    string_destroy(r);
+}
+
+Test(http_parser, target_too_long)
+{
+    struct string *r = make_request("GET /");
+    for (size_t i = 0; i < PATH_MAX; i++)
+        string_concat_str(r, "a", 1);
+    string_concat_str(r, " HTTP/1.1\r\nHost: example.com\r\n\r\n",
+                      strlen(" HTTP/1.1\r\nHost: example.com\r\n\r\n"));
+    struct config *config = make_config_with_server_name("example.com");
+    struct request_header req_header;
+    parse_request(r, config, &req_header);
+
+    cr_expect_eq(req_header.status, URI_TOO_LONG, "expected 414 but got %d",
+                 req_header.status);
+    cr_expect_str_eq(req_header.filename, "");
+
+    config_destroy(config);
+    string_destroy(r);
+}
+
+Test(http_parser, incremental_feed)
+{
+    const char *request =
+        "GET /index.html HTTP/1.1\r\nHost: example.com\r\n\r\n";
+    struct config *config = make_config_with_server_name("example.com");
+    struct http_parser parser;
+    http_parser_init(&parser);
+
+    // Feed one more byte at a time, as if each arrived in its own segment
+    struct string r = { .size = 0, .data = (char *)request };
+    enum parse_result result = PARSE_NEED_MORE;
+    while (result == PARSE_NEED_MORE && r.size < strlen(request))
+    {
+        r.size++;
+        result = http_parser_feed(&parser, &r);
+    }
+
+    cr_expect_eq(result, PARSE_COMPLETE, "expected complete but got %d",
+                 result);
+    cr_expect_eq(parser.position, strlen(request));
+
+    struct request_header req_header;
+    http_parser_finish(&parser, &r, config, &req_header);
+    cr_expect_eq(req_header.status, OK);
+    cr_expect_str_eq(req_header.filename, "/index.html");
+
+    config_destroy(config);
+}
+
+Test(http_parser, garbage_rejected_early)
+{
+    struct string r = { .size = 3, .data = "GE\x01" };
+    struct http_parser parser;
+    http_parser_init(&parser);
+
+    cr_expect_eq(http_parser_feed(&parser, &r), PARSE_ERROR);
+}
+
+Test(http_parser, oversized_header_rejected)
+{
+    struct string *r = make_request("GET / HTTP/1.1\r\nX: ");
+    for (size_t i = 0; i < REQUEST_HEADER_MAX; i++)
+        string_concat_str(r, "a", 1);
+    struct http_parser parser;
+    http_parser_init(&parser);
+
+    cr_expect_eq(http_parser_feed(&parser, r), PARSE_ERROR);
+
+    // Received in one read, the end of the header does not make it fit
+    string_concat_str(r, "\r\n\r\n", 4);
+    http_parser_init(&parser);
+    cr_expect_eq(http_parser_feed(&parser, r), PARSE_ERROR);
+    string_destroy(r);
+}
+
+Test(http_parser, long_fields_scanned_in_blocks)
+{
+    const char *request = "GET /a/rather/long/path/to/some/file.html?q=1 "
+                          "HTTP/1.1\r\n"
+                          "X-Very|Long~Field-Name-Spanning-Blocks:   "
+                          "value with spaces and,punctuation;q=0.9   \r\n"
+                          "Host: example.com\r\n\r\n";
+    struct string *r = make_request(request);
+    struct config *config = make_config_with_server_name("example.com");
+
+    // Vectorized and scalar scanners must agree
+    for (int simd = 0; simd < 2; simd++)
+    {
+        scan_use_simd(simd);
+        struct request_header req_header;
+        parse_request(r, config, &req_header);
+
+        cr_expect_eq(req_header.status, OK, "simd %d: got status %d", simd,
+                     req_header.status);
+        cr_expect_eq(req_header.target.size, 41, "simd %d: got %zu", simd,
+                     req_header.target.size);
+        cr_expect_eq(req_header.host.size, 11, "simd %d: got %zu", simd,
+                     req_header.host.size);
+    }
+
+    cr_expect(scan_token("Field|Name~With-Tchars-Only!#$%:", 32) == 31);
+    cr_expect(scan_visible("not\x7f", 4) == 3);
+
+    config_destroy(config);
+    string_destroy(r);
+}
+
+Test(http_parser, field_table)
+{
+    const char *request = "GET / HTTP/1.1\r\n"
+                          "HOST: example.com\r\n"
+                          "if-none-match: \"abc\"\r\n"
+                          "X-Custom:  kept  \r\n"
+                          "Accept-Encoding: gzip, br\r\n"
+                          "Range: bytes=0-9\r\n"
+                          "Rangf: not known\r\n\r\n";
+    struct string *r = make_request(request);
+    struct config *config = make_config_with_server_name("example.com");
+    struct request_header req_header;
+    parse_request(r, config, &req_header);
+
+    cr_assert_eq(req_header.status, OK);
+    cr_expect_eq(req_header.field_count, 6);
+    cr_expect_eq(req_header.fields[2].id, FIELD_OTHER);
+    cr_expect_eq(req_header.fields[2].value.size, 4, "blanks are trimmed");
+    cr_expect_eq(req_header.fields[5].id, FIELD_OTHER);
+
+    const struct string *etag =
+        get_request_field(&req_header, FIELD_IF_NONE_MATCH);
+    cr_assert_not_null(etag);
+    cr_expect(etag->size == 5 && !memcmp(etag->data, "\"abc\"", 5));
+    cr_expect_not_null(get_request_field(&req_header, FIELD_ACCEPT_ENCODING));
+    cr_expect_not_null(get_request_field(&req_header, FIELD_RANGE));
+    cr_expect_null(get_request_field(&req_header, FIELD_COOKIE));
+
+    config_destroy(config);
+    string_destroy(r);
+}
+
+Test(http_parser, too_many_fields)
+{
+    char request[HEADER_FIELDS_MAX * 8 + 64] = "GET / HTTP/1.1\r\n";
+    for (int i = 0; i <= HEADER_FIELDS_MAX; i++)
+        strcat(request, "X-A: b\r\n");
+    strcat(request, "\r\n");
+    struct string *r = make_request(request);
+    struct config *config = make_config_with_server_name("example.com");
+    struct request_header req_header;
+    parse_request(r, config, &req_header);
+
+    cr_expect_eq(req_header.status, BAD_REQUEST);
+
+    config_destroy(config);
+    string_destroy(r);
+}
+
+Test(http_parser, known_field_names)
+{
+    static const char *names[] = {
+        "Connection", "Content-Length", "Transfer-Encoding", "Expect",
+        "If-None-Match", "If-Modified-Since", "If-Range", "Range", "Accept",
+        "Accept-Encoding", "User-Agent", "Referer", "Cookie"
+    };
+    struct config *config = make_config_with_server_name("example.com");
+
+    // Every name must land in its own slot of the perfect hash
+    for (size_t i = 0; i < sizeof(names) / sizeof(*names); i++)
+    {
+        char request[128];
+        sprintf(request, "GET / HTTP/1.1\r\nHost: example.com\r\n%s: v\r\n\r\n",
+                names[i]);
+        struct string *r = make_request(request);
+        struct request_header req_header;
+        parse_request(r, config, &req_header);
+
+        cr_expect_eq(req_header.fields[1].id, FIELD_CONNECTION + i,
+                     "%s not recognized", names[i]);
+        string_destroy(r);
+    }
+
+    config_destroy(config);
+}
+
+Test(http_parser, request_bodies)
+{
+    static const struct
+    {
+        const char *request;
+        enum request_status status;
+        bool has_body;
+    } cases[] = {
+        { "GET / HTTP/1.1\r\nHost: example.com\r\n\r\n", OK, false },
+        { "GET / HTTP/1.1\r\nHost: example.com\r\nContent-Length: 00\r\n"
+          "\r\n",
+          OK, false },
+        { "GET / HTTP/1.1\r\nHost: example.com\r\nContent-Length: 5\r\n\r\n",
+          OK, true },
+        { "POST / HTTP/1.1\r\nHost: example.com\r\nContent-Length: 5\r\n"
+          "\r\n",
+          METHOD_NOT_ALLOWED, true },
+        { "GET / HTTP/1.1\r\nHost: example.com\r\nTransfer-Encoding: "
+          "chunked\r\n\r\n",
+          OK, true },
+        { "GET / HTTP/1.1\r\nHost: example.com\r\nContent-Length: 5\r\n"
+          "Transfer-Encoding: chunked\r\n\r\n",
+          BAD_REQUEST, true },
+        { "GET / HTTP/1.1\r\nHost: example.com\r\nContent-Length: 5\r\n"
+          "Content-Length: 6\r\n\r\n",
+          BAD_REQUEST, false },
+        { "GET / HTTP/1.1\r\nHost: example.com\r\nContent-Length: -1\r\n"
+          "\r\n",
+          BAD_REQUEST, false },
+    };
+
+    struct config *config = make_config_with_server_name("example.com");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); i++)
+    {
+        struct string *r = make_request(cases[i].request);
+        struct request_header req_header;
+        parse_request(r, config, &req_header);
+
+        cr_expect_eq(req_header.status, cases[i].status, "case %zu: got %d", i,
+                     req_header.status);
+        cr_expect_eq(req_header.has_body, cases[i].has_body, "case %zu", i);
+        string_destroy(r);
+    }
+    config_destroy(config);
+}
+
+static bool not_modified(const char *fields, const char *etag, time_t mtime)
+{
+    char request[512];
+    sprintf(request, "GET / HTTP/1.1\r\nHost: example.com\r\n%s\r\n", fields);
+    struct string *r = make_request(request);
+    struct config *config = make_config_with_server_name("example.com");
+    struct request_header req_header;
+    parse_request(r, config, &req_header);
+    cr_assert_eq(req_header.status, OK);
+
+    bool result = request_not_modified(&req_header, etag, mtime);
+    config_destroy(config);
+    string_destroy(r);
+    return result;
+}
+
+Test(http_parser, conditional_requests)
+{
+    // Sun, 06 Nov 1994 08:49:37 GMT
+    time_t mtime = 784111777;
+    const char *etag = "\"1a-2b-3c\"";
+
+    cr_expect(not_modified("If-None-Match: \"x\", W/\"1a-2b-3c\"\r\n", etag,
+                           mtime),
+              "Weak comparison should ignore W/");
+    cr_expect(not_modified("If-None-Match: *\r\n", etag, mtime));
+    cr_expect(!not_modified("If-None-Match: \"1a-2b\"\r\n", etag, mtime));
+    cr_expect(not_modified(
+        "If-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n", etag, mtime));
+    cr_expect(!not_modified(
+        "If-Modified-Since: Sun, 06 Nov 1994 08:49:36 GMT\r\n", etag, mtime));
+    cr_expect(!not_modified("If-Modified-Since: Sunday, 06-Nov-94 08:49:37 "
+                            "GMT\r\n",
+                            etag, mtime),
+              "Obsolete dates should be ignored");
+    cr_expect(!not_modified("If-None-Match: \"other\"\r\n"
+                            "If-Modified-Since: Sun, 06 Nov 1994 08:49:37 "
+                            "GMT\r\n",
+                            etag, mtime),
+              "If-Modified-Since should be ignored after If-None-Match");
+    cr_expect(!not_modified("", etag, mtime));
+}
+
+static int ranges_of(const char *value, off_t size, struct byte_range *ranges)
+{
+    struct string field = { strlen(value), (char *)value, 0 };
+    return parse_ranges(&field, size, ranges);
+}
+
+Test(http_parser, byte_ranges)
+{
+    struct byte_range ranges[RANGES_MAX];
+
+    cr_assert_eq(ranges_of("bytes=0-499, -200,9000-", 10000, ranges), 3);
+    cr_expect(ranges[0].start == 0 && ranges[0].length == 500);
+    cr_expect(ranges[1].start == 9800 && ranges[1].length == 200);
+    cr_expect(ranges[2].start == 9000 && ranges[2].length == 1000);
+
+    cr_assert_eq(ranges_of("bytes=5-99999", 100, ranges), 1);
+    cr_expect(ranges[0].start == 5 && ranges[0].length == 95,
+              "Last position should be clamped to the size");
+    cr_assert_eq(ranges_of("bytes=-500", 100, ranges), 1);
+    cr_expect(ranges[0].start == 0 && ranges[0].length == 100);
+
+    cr_expect_eq(ranges_of("bytes=100-", 100, ranges), -1);
+    cr_expect_eq(ranges_of("bytes=-0", 100, ranges), -1);
+    cr_expect_eq(ranges_of("bytes=200-300, 0-1", 100, ranges), 1,
+                 "Unsatisfiable ranges should be dropped");
+
+    cr_expect_eq(ranges_of("bytes=5-1", 100, ranges), 0);
+    cr_expect_eq(ranges_of("items=0-1", 100, ranges), 0);
+    cr_expect_eq(ranges_of("bytes=", 100, ranges), 0);
+    cr_expect_eq(ranges_of("bytes=0-1;", 100, ranges), 0);
+    cr_expect_eq(ranges_of("bytes=0-0,1-1,2-2,3-3,4-4,5-5,6-6,7-7,8-8,9-9,"
+                           "10-10,11-11,12-12,13-13,14-14,15-15,16-16",
+                           100, ranges),
+                 0, "Too many ranges should be ignored");
+}
+
+static enum content_coding coding_for(const char *fields, unsigned available)
+{
+    char request[512];
+    sprintf(request, "GET / HTTP/1.1\r\nHost: example.com\r\n%s\r\n", fields);
+    struct string *r = make_request(request);
+    struct config *config = make_config_with_server_name("example.com");
+    struct request_header req_header;
+    parse_request(r, config, &req_header);
+    cr_assert_eq(req_header.status, OK);
+
+    enum content_coding coding = negotiate_coding(&req_header, available);
+    config_destroy(config);
+    string_destroy(r);
+    return coding;
+}
+
+Test(http_parser, content_negotiation)
+{
+    unsigned all = (1u << CODING_COUNT) - 1;
+    unsigned gzip = 1u << CODING_GZIP;
+
+    cr_expect_eq(coding_for("Accept-Encoding: gzip, deflate, br, zstd\r\n",
+                            all),
+                 CODING_BR, "Ties should go to the most preferred coding");
+    cr_expect_eq(coding_for("Accept-Encoding: br;q=0.5, gzip\r\n", all),
+                 CODING_GZIP);
+    cr_expect_eq(coding_for("Accept-Encoding: gzip;q=0.001\r\n", all),
+                 CODING_GZIP);
+    cr_expect_eq(coding_for("Accept-Encoding: br\r\n", gzip),
+                 CODING_IDENTITY, "Only available codings should be chosen");
+    cr_expect_eq(coding_for("Accept-Encoding: gzip;q=0\r\n", all),
+                 CODING_IDENTITY, "q=0 should exclude a coding");
+    cr_expect_eq(coding_for("Accept-Encoding: *;q=0.2, br;q=0\r\n", all),
+                 CODING_ZSTD);
+    cr_expect_eq(coding_for("Accept-Encoding: x-gzip\r\n", all),
+                 CODING_GZIP);
+    cr_expect_eq(coding_for("Accept-Encoding: zstd;q=0.5\r\n"
+                            "Accept-Encoding: GZIP ; Q=0.9\r\n",
+                            all),
+                 CODING_GZIP, "Every field should be read");
+    cr_expect_eq(coding_for("Accept-Encoding: gzip;q=1.5\r\n", all),
+                 CODING_IDENTITY, "Invalid q values should be ignored");
+    cr_expect_eq(coding_for("", all), CODING_IDENTITY);
+    cr_expect_eq(coding_for("Accept-Encoding: gzip;q=0.1, identity;q=1\r\n",
+                            all),
+                 CODING_IDENTITY, "Preferred identity should be chosen");
+    cr_expect_eq(coding_for("Accept-Encoding: gzip, identity;q=0.5\r\n",
+                            all),
+                 CODING_GZIP);
+    cr_expect_eq(coding_for("Accept-Encoding: *;q=0.5, gzip;q=0.1\r\n",
+                            gzip),
+                 CODING_IDENTITY, "Identity should get the weight of *");
+}
@@ -1,5 +1,6 @@
 #include <criterion/criterion.h>
 #include <string.h>
+#include <time.h>
 
 #include "../../src/http/http.h"
 #include "../../src/utils/string/string.h"
@@ -17,14 +18,41 @@ static bool contains_substr(const char *buf, size_t n, const char *needle)
     return false;
 }
 
-TestSuite(response_generator);
+// Join the parts of a header the way writev sends them
+static size_t flatten(const struct header_parts *header, char *buf)
+{
+    size_t size = 0;
+    for (size_t i = 0; i < header->count; ++i)
+    {
+        memcpy(buf + size, header->parts[i].iov_base, header->parts[i].iov_len);
+        size += header->parts[i].iov_len;
+    }
+    return size;
+}
+
+static struct arena arena;
+static struct http_date date;
+
+static void setup(void)
+{
+    arena_init(&arena, 1024);
+    http_date_update(&date, time(NULL));
+}
+
+static void teardown(void)
+{
+    arena_destroy(&arena);
+}
+
+TestSuite(response_generator, .init = setup, .fini = teardown);
 
 Test(response_generator, ok_response)
 {
     struct request_header request = { 0 };
     request.status = OK;
 
-    struct response_header *res = create_response(&request, 12345);
+    struct response_header *res =
+        create_response(&request, 12345, &date, &arena);
     cr_assert_not_null(res, "Response header should not be NULL");
     cr_assert_not_null(res->status, "Status string should not be NULL");
     cr_assert_not_null(res->date, "Date string should not be NULL");
@@ -45,7 +73,6 @@ Test(response_generator, ok_response)
     cr_expect_eq(res->content_length, 12345,
                  "Expected content length 12345, got %ld", res->content_length);
 
-    destroy_response(res);
 }
 
 Test(response_generator, bad_request)
@@ -53,7 +80,7 @@ Test(response_generator, bad_request)
     struct request_header request = { 0 };
     request.status = BAD_REQUEST;
 
-    struct response_header *res = create_response(&request, 0);
+    struct response_header *res = create_response(&request, 0, &date, &arena);
     cr_assert_not_null(res, "Response header should not be NULL");
     const char *expected = HTTP_VERSION " 400 Bad Request";
     size_t expected_len = strlen(HTTP_VERSION) + strlen(" 400 Bad Request");
@@ -64,7 +91,6 @@ Test(response_generator, bad_request)
     cr_expect(memcmp(res->status->data, expected, expected_len) == 0,
               "Status strings do not match");
 
-    destroy_response(res);
 }
 
 Test(response_generator, various_status_strings)
@@ -72,64 +98,141 @@ Test(response_generator, various_status_strings)
     struct request_header request = { 0 };
 
     request.status = FORBIDDEN;
-    struct response_header *r1 = create_response(&request, 0);
+    struct response_header *r1 = create_response(&request, 0, &date, &arena);
     cr_expect_not_null(r1, "Response header should not be NULL");
     cr_expect(memcmp(r1->status->data, HTTP_VERSION " 403 Forbidden",
                      r1->status->size)
                   == 0,
               "Status strings do not match");
-    destroy_response(r1);
 
     request.status = NOT_FOUND;
-    struct response_header *r2 = create_response(&request, 0);
+    struct response_header *r2 = create_response(&request, 0, &date, &arena);
     cr_expect_not_null(r2, "Response header should not be NULL");
     cr_expect(memcmp(r2->status->data, HTTP_VERSION " 404 Not Found",
                      r2->status->size)
                   == 0,
               "Status strings do not match");
-    destroy_response(r2);
 
     request.status = METHOD_NOT_ALLOWED;
-    struct response_header *r3 = create_response(&request, 0);
+    struct response_header *r3 = create_response(&request, 0, &date, &arena);
     cr_expect_not_null(r3, "Response header should not be NULL");
     cr_expect(memcmp(r3->status->data, HTTP_VERSION " 405 Method Not Allowed",
                      r3->status->size)
                   == 0,
               "Status strings do not match");
-    destroy_response(r3);
 
     request.status = UNSUPPORTED_VERSION;
-    struct response_header *r4 = create_response(&request, 0);
+    struct response_header *r4 = create_response(&request, 0, &date, &arena);
     cr_expect_not_null(r4, "Response header should not be NULL");
     cr_expect(memcmp(r4->status->data,
                      HTTP_VERSION " 505 HTTP Version Not Supported",
                      r4->status->size)
                   == 0,
               "Status strings do not match");
-    destroy_response(r4);
 }
 
 Test(response_generator, default_internal_server_error)
 {
     struct request_header request = { 0 };
     request.status = 0;
-    struct response_header *r = create_response(&request, 0);
+    struct response_header *r = create_response(&request, 0, &date, &arena);
     cr_expect_not_null(r, "Response header should not be NULL");
     cr_expect(memcmp(r->status->data, HTTP_VERSION " 500 Internal Server Error",
                      r->status->size)
                   == 0,
               "Status strings do not match");
-    destroy_response(r);
 }
 
 Test(response_generator, date_contains_gmt_and_nonzero_length)
 {
     struct request_header request = { 0 };
     request.status = OK;
-    struct response_header *r = create_response(&request, 10);
+    struct response_header *r = create_response(&request, 10, &date, &arena);
     cr_expect_not_null(r, "Response header should not be NULL");
     cr_expect(r->date->size > 0, "Date string size should not be zero");
     cr_expect(contains_substr(r->date->data, r->date->size, "GMT"),
               "Date string should contain 'GMT'");
-    destroy_response(r);
+}
+
+Test(response_generator, connection_header)
+{
+    struct request_header request = { 0 };
+    request.status = OK;
+
+    request.keep_alive = true;
+    struct response_header *r1 = create_response(&request, 0, &date, &arena);
+    struct header_parts *h1 = response_header_to_parts(r1, &arena);
+    char s1[256];
+    cr_assert(h1->size <= sizeof(s1));
+    cr_expect_eq(flatten(h1, s1), h1->size, "Parts should add up to size");
+    cr_expect(contains_substr(s1, h1->size, "Connection: keep-alive\r\n"),
+              "Persistent response should advertise keep-alive");
+
+    request.keep_alive = false;
+    struct response_header *r2 = create_response(&request, 0, &date, &arena);
+    struct header_parts *h2 = response_header_to_parts(r2, &arena);
+    char s2[256];
+    cr_assert(h2->size <= sizeof(s2));
+    flatten(h2, s2);
+    cr_expect(contains_substr(s2, h2->size, "Connection: close\r\n"),
+              "Non persistent response should advertise close");
+}
+
+Test(response_generator, not_modified_response)
+{
+    struct request_header request = { 0 };
+    request.status = NOT_MODIFIED;
+
+    struct response_header *r = create_response(&request, 1725, &date, &arena);
+    r->etag = "\"1a-2b-3c\"";
+    r->last_modified = "Sun, 06 Nov 1994 08:49:37 GMT";
+    struct header_parts *h = response_header_to_parts(r, &arena);
+    char s[512];
+    cr_assert(h->size <= sizeof(s));
+    flatten(h, s);
+
+    cr_expect(contains_substr(s, h->size, HTTP_VERSION " 304 Not Modified"));
+    cr_expect(contains_substr(s, h->size, "ETag: \"1a-2b-3c\"\r\n"));
+    cr_expect(contains_substr(s, h->size,
+                              "Last-Modified: Sun, 06 Nov 1994 08:49:37 "
+                              "GMT\r\n"));
+    cr_expect(!contains_substr(s, h->size, "Content-Length"),
+              "304 responses have no body to frame");
+}
+
+Test(response_generator, multipart_byteranges)
+{
+    static const struct byte_range ranges[] = { { 0, 10 }, { 90, 10 } };
+    struct request_header request = { 0 };
+    request.status = PARTIAL_CONTENT;
+
+    struct response_header *r = create_response(&request, 0, &date, &arena);
+    r->ranges = ranges;
+    r->range_count = 2;
+    r->file_size = 100;
+    r->content_length = multipart_length(r);
+
+    // Body as sent: delimiters around the ranges of the file
+    char body[512];
+    size_t size = 0;
+    for (size_t i = 0; i <= r->range_count; i++)
+    {
+        struct header_parts *part = multipart_header(r, i, &arena);
+        size += flatten(part, body + size);
+        if (i < r->range_count)
+        {
+            memset(body + size, 'x', ranges[i].length);
+            size += ranges[i].length;
+        }
+    }
+    cr_expect_eq((off_t)size, r->content_length);
+    cr_expect(contains_substr(body, size, "Content-Range: bytes 90-99/100"));
+    cr_expect(contains_substr(body, size - 4, "--\r\n") == false,
+              "Only the last delimiter should close the body");
+
+    struct header_parts *h = response_header_to_parts(r, &arena);
+    char s[512];
+    flatten(h, s);
+    cr_expect(contains_substr(s, h->size, " 206 Partial Content"));
+    cr_expect(contains_substr(s, h->size, "multipart/byteranges; boundary="));
 }
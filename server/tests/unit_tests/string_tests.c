@@ -0,0 +1,63 @@
+#include <criterion/criterion.h>
+#include <string.h>
+
+#include "../../src/utils/string/string.h"
+
+TestSuite(string);
+
+Test(string, concat_grows_geometrically)
+{
+    struct string *str = string_create("", 0);
+    size_t reallocs = 0;
+    size_t capacity = str->capacity;
+
+    for (int i = 0; i < 1000; i++)
+    {
+        string_concat_str(str, "abcd", 4);
+        reallocs += str->capacity != capacity;
+        capacity = str->capacity;
+    }
+
+    cr_expect_eq(str->size, 4000, "Expected 4000 bytes, got %zu", str->size);
+    cr_expect_geq(str->capacity, str->size);
+    cr_expect_leq(reallocs, 8, "Expected few reallocations, got %zu",
+                  reallocs);
+    cr_expect(!memcmp(str->data + 3996, "abcd", 4), "Data should be kept");
+
+    string_destroy(str);
+}
+
+Test(string, reset_keeps_memory)
+{
+    struct string *str = string_create("hello", 5);
+    cr_assert(string_reserve(str, 100));
+    size_t capacity = str->capacity;
+    char *data = str->data;
+
+    string_reset(str);
+    string_concat_str(str, "world", 5);
+
+    cr_expect_eq(str->size, 5);
+    cr_expect_eq(str->capacity, capacity, "Capacity should be kept");
+    cr_expect_eq(str->data, data, "Memory should be reused");
+    cr_expect(!memcmp(str->data, "world", 5));
+
+    string_destroy(str);
+}
+
+Test(string, shrink_gives_memory_back)
+{
+    struct string *str = string_create("hello", 5);
+    cr_assert(string_reserve(str, 10000));
+
+    string_shrink(str, 64);
+    cr_expect_eq(str->size, 0);
+    cr_expect_eq(str->capacity, 64, "Capacity should be shrunk");
+
+    string_shrink(str, 128);
+    cr_expect_eq(str->capacity, 64, "Smaller capacity should be kept");
+    cr_expect(string_concat_str(str, "world", 5));
+    cr_expect(!memcmp(str->data, "world", 5));
+
+    string_destroy(str);
+}
@@ -0,0 +1,133 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/http/http.h"
+#include "../src/logger/access_log.h"
+
+// Enough for the longest record the server writes
+#define READ_BUFFER_SIZE 65536
+
+static const char *method_name(uint8_t method)
+{
+    if (method == GET)
+        return "GET";
+    if (method == HEAD)
+        return "HEAD";
+    return "UNKNOWN";
+}
+
+static void format_ip(uint32_t ip, char *buffer)
+{
+    sprintf(buffer, "%u.%u.%u.%u", ip >> 24, (ip >> 16) & 0xff,
+            (ip >> 8) & 0xff, ip & 0xff);
+}
+
+static void print_json_string(const char *data, size_t size)
+{
+    putchar('"');
+    for (size_t i = 0; i < size; i++)
+    {
+        unsigned char c = data[i];
+        if (c == '"' || c == '\\')
+            printf("\\%c", c);
+        else if (c < 0x20 || c >= 0x7f)
+            printf("\\u%04x", c);
+        else
+            putchar(c);
+    }
+    putchar('"');
+}
+
+static void print_entry(const struct access_entry *entry, bool json)
+{
+    char ip[16];
+    format_ip(entry->client_ip, ip);
+
+    if (json)
+    {
+        printf("{\"time\":%llu,\"client\":\"%s\",\"method\":\"%s\","
+               "\"target\":",
+               (unsigned long long)entry->time, ip,
+               method_name(entry->method));
+        print_json_string(entry->target, entry->target_length);
+        printf(",\"status\":%u,\"bytes\":%llu,\"latency_us\":%u}\n",
+               entry->status, (unsigned long long)entry->bytes,
+               entry->latency);
+        return;
+    }
+
+    // Same time format as the text log
+    time_t time = entry->time;
+    struct tm tm_info;
+    gmtime_r(&time, &tm_info);
+    char time_str[30];
+    strftime(time_str, sizeof(time_str), "%a, %d %b %Y %H:%M:%S GMT", &tm_info);
+    printf("%s %s %s '%.*s' %u %llu bytes %u us\n", time_str, ip,
+           method_name(entry->method), (int)entry->target_length,
+           entry->target, entry->status, (unsigned long long)entry->bytes,
+           entry->latency);
+}
+
+static int decode(FILE *file, bool json)
+{
+    static unsigned char buffer[READ_BUFFER_SIZE];
+    size_t size = fread(buffer, 1, READ_BUFFER_SIZE, file);
+    if (!access_log_check_header(buffer, size))
+    {
+        fputs("access-log-decode: not an access log of this version\n",
+              stderr);
+        return 1;
+    }
+
+    size_t start = ACCESS_LOG_HEADER_SIZE;
+    for (;;)
+    {
+        struct access_entry entry;
+        size_t length = access_log_decode(buffer + start, size - start, &entry);
+        if (length)
+        {
+            print_entry(&entry, json);
+            start += length;
+            continue;
+        }
+
+        // Keep the partial record and read the rest of it
+        memmove(buffer, buffer + start, size - start);
+        size -= start;
+        start = 0;
+        size_t read = fread(buffer + size, 1, READ_BUFFER_SIZE - size, file);
+        if (!read)
+            break;
+        size += read;
+    }
+
+    if (size)
+        fprintf(stderr, "access-log-decode: %zu trailing bytes ignored\n",
+                size);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    bool json = argc == 3 && !strcmp(argv[1], "--json");
+    if (argc != 2 && !json)
+    {
+        fputs("Usage: access-log-decode [--json] <access_log>\n", stderr);
+        return 2;
+    }
+
+    FILE *file = fopen(argv[argc - 1], "rb");
+    if (!file)
+    {
+        perror(argv[argc - 1]);
+        return 1;
+    }
+
+    int status = decode(file, json);
+    fclose(file);
+    return status;
+}
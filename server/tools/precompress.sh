@@ -0,0 +1,88 @@
+#!/usr/bin/env bash
+
+# Write the .br, .zst and .gz siblings the server sends with
+# --precompressed true next to the compressible files of a root directory.
+# A sibling is kept only when it is smaller than the file, and gets the
+# file's modification time: the server ignores siblings older than their
+# file. Codings whose compressor is not installed are skipped.
+#
+# Environment:
+#   PRECOMPRESS_MIN_SIZE  files smaller than this are left alone
+#                         (default: 1024)
+#   PRECOMPRESS_TYPES     extensions of the files compressed
+#                         (default: html css js mjs json svg txt xml wasm
+#                         map ico)
+
+if [ $# -ne 1 ] || [ ! -d "$1" ]; then
+    echo "Usage: $0 <root_dir>"
+    exit 2
+fi
+
+ROOT="$1"
+MIN_SIZE="${PRECOMPRESS_MIN_SIZE:-1024}"
+TYPES="${PRECOMPRESS_TYPES:-html css js mjs json svg txt xml wasm map ico}"
+
+# Coding suffix and command compressing stdin to stdout, most preferred
+# first like the server
+CODINGS=(
+    ".br:brotli -q 11 -c"
+    ".zst:zstd -19 -q -c"
+    ".gz:gzip -9 -n -c"
+)
+
+is_compressible() {
+    local name="${1##*/}"
+    [[ "$name" == *.* ]] || return 1
+    local extension="${name##*.}"
+    for type in $TYPES; do
+        [ "${extension,,}" = "$type" ] && return 0
+    done
+    return 1
+}
+
+# Compress file with one coding, dropping the result when it saves nothing
+compress() {
+    local file="$1" suffix="$2" command="$3"
+    local out="$file$suffix"
+    local tmp
+    tmp=$(mktemp "$out.XXXXXX") || return 1
+
+    if ! $command < "$file" > "$tmp"; then
+        rm -f "$tmp"
+        echo "$0: $command failed on $file" >&2
+        return 1
+    fi
+    if [ "$(stat -c %s "$tmp")" -ge "$(stat -c %s "$file")" ]; then
+        rm -f "$tmp" "$out"
+        return 0
+    fi
+
+    chmod --reference="$file" "$tmp"
+    touch -r "$file" "$tmp"
+    mv -f "$tmp" "$out"
+    written=$((written + 1))
+}
+
+available=()
+for coding in "${CODINGS[@]}"; do
+    command="${coding#*:}"
+    if command -v "${command%% *}" > /dev/null; then
+        available+=("$coding")
+    else
+        echo "$0: ${command%% *} not found, skipping ${coding%%:*}" >&2
+    fi
+done
+
+status=0
+written=0
+while IFS= read -r -d '' file; do
+    is_compressible "$file" || continue
+    [ "$(stat -c %s "$file")" -ge "$MIN_SIZE" ] || continue
+    for coding in "${available[@]}"; do
+        compress "$file" "${coding%%:*}" "${coding#*:}" || status=1
+    done
+done < <(find "$ROOT" -type f ! -name '*.br' ! -name '*.zst' ! -name '*.gz' \
+              -print0)
+
+echo "$written precompressed files written under $ROOT"
+exit $status